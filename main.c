@@ -1,24 +1,47 @@
 #include <raylib.h>
 #include <raymath.h>
+#include <rlgl.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include<math.h>
+#include "telemetry.h"
+#include "waves.h"
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 //--------------------------- constants ----------------------
-#define SCR_W                 800
-#define SCR_H                 600
+#define ARENA_W               800     // logical play field; gameplay never sees the window
+#define ARENA_H               600
+#define WINDOW_W              800     // initial window size, resizable afterwards
+#define WINDOW_H              600
 #define BULLET_POOL           100
-#define ENEMY_POOL            10000
+#define ENEMY_POOL            100000
 #define SPAWN_POINTS          8
 #define BULLET_RADIUS         3.0f
 #define PLAYER_SIZE           20
+#define ENEMY_SIZE            10
+#define SIM_HZ                120     // fixed simulation tick rate
+#define INPUT_QUEUE           64      // render -> sim input frames in flight
 //#define DEG2RAD               (PI / 180.0f)
 #define CLAMP(x, min, max)    ((x) < (min) ? (min) : ((x) > (max) ? (max) : (x)))
 enum Game{
   START,
   PLAYING,
-  END  
+  END,
+  PAUSED,
+  GAME_STATES
 };
 Sound shooting_sound;
 Sound hit_sound;
@@ -32,45 +55,792 @@ static inline Vector2 v2_scale_add(Vector2 v, float s, Vector2 add) {
     return (Vector2){ v.x + add.x * s, v.y + add.y * s };
 }
 
+// Per-thread xorshift64* so every simulation thread has its own
+// reproducible stream (rand()/GetRandomValue share global state).
+static _Thread_local uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+static void rng_seed(uint64_t seed) {
+    rng_state = seed * 0x9E3779B97F4A7C15ull + 0x632BE59BD9B4E019ull;
+}
+
+static inline uint32_t rng_u32(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint32_t)((rng_state * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static inline int rng_range(int min, int max) {     // inclusive
+    return min + (int)(rng_u32() % (uint32_t)(max - min + 1));
+}
+
 static inline float randf(float min, float max) {
-    return min + ((float)rand() / (float)RAND_MAX) * (max - min);
+    return min + (rng_u32() * (1.0f / 4294967296.0f)) * (max - min);
 }
 
-//--------------------------- bullets ------------------------
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void sleep_until(double t) {
+    struct timespec ts = { (time_t)t, (long)((t - (double)(time_t)t) * 1e9) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {}
+}
+
+//--------------------------- input --------------------------
+// Sampled once per rendered frame on the main thread and handed to the
+// simulation, which never touches raylib's input functions itself.
 typedef struct {
-    bool   active;
-    float  damage;
-    float  lifespan, lifeTimer;
-    float  speed;
-    Vector2 pos, dir;
-} Bullet;
+    Vector2 move;        // raw WASD axes
+    Vector2 mouse;
+    bool    fire;        // held
+    bool    quit;        // pressed this frame
+    double  stamp;       // now_seconds() at sampling, for input-to-submit latency
+} InputFrame;
 
-static void bullet_pool_init(Bullet pool[BULLET_POOL]) {
-    for (int i = 0; i < BULLET_POOL; ++i)
-        pool[i] = (Bullet){ .active = false, .damage = 50, .lifespan = 0.4f, .speed = 1000 };
+// Lets whoever owns the input stream hand over a fresher frame right
+// before a shot leaves. Left empty where input is synthesized.
+typedef struct {
+    const InputFrame *(*fn)(void *ctx);
+    void             *ctx;
+} InputLatch;
+
+// Call right before handing the frame over: raylib polls events at the end
+// of EndDrawing, so this is the freshest state there is. `viewport` is where
+// the arena currently sits in the window; the mouse comes back in arena units.
+static InputFrame input_sample(Rectangle viewport) {
+    InputFrame in = { .stamp = now_seconds() };
+    if (IsKeyDown(KEY_W)) in.move.y -= 1;
+    if (IsKeyDown(KEY_S)) in.move.y += 1;
+    if (IsKeyDown(KEY_A)) in.move.x -= 1;
+    if (IsKeyDown(KEY_D)) in.move.x += 1;
+    Vector2 m = GetMousePosition();
+    in.mouse = (Vector2){ (m.x - viewport.x) * ARENA_W / viewport.width,
+                          (m.y - viewport.y) * ARENA_H / viewport.height };
+    in.fire  = IsMouseButtonDown(MOUSE_BUTTON_LEFT);
+    in.quit  = IsKeyPressed(KEY_Q);
+    return in;
 }
 
-static void bullet_spawn(Bullet pool[BULLET_POOL], Vector2 pos, Vector2 dir) {
-    for (int i = 0; i < BULLET_POOL; ++i) {
-        Bullet *b = &pool[i];
-        if (!b->active) {
-            *b = (Bullet){ .active = true, .damage = 50, .lifespan = 0.4f,
-                           .speed = 1000, .pos = pos, .dir = dir };
-            break;
+//--------------------------- spsc ring ----------------------
+// Bounded lock-free queue of fixed-size records, one producer thread and
+// one consumer thread. Capacity must be a power of two.
+typedef struct {
+    _Alignas(64) _Atomic uint32_t head;     // written by producer
+    _Alignas(64) _Atomic uint32_t tail;     // written by consumer
+    _Alignas(64) uint32_t mask;
+    uint32_t stride;
+    unsigned char *slots;
+} SpscRing;
+
+static void spsc_init(SpscRing *r, void *storage, uint32_t capacity, uint32_t stride) {
+    atomic_store(&r->head, 0);
+    atomic_store(&r->tail, 0);
+    r->mask   = capacity - 1;
+    r->stride = stride;
+    r->slots  = storage;
+}
+
+static bool spsc_push(SpscRing *r, const void *item) {
+    uint32_t h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    uint32_t t = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (h - t > r->mask) return false;                  // full
+    memcpy(r->slots + (size_t)(h & r->mask) * r->stride, item, r->stride);
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+    return true;
+}
+
+static bool spsc_pop(SpscRing *r, void *item) {
+    uint32_t t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    uint32_t h = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (h == t) return false;                           // empty
+    memcpy(item, r->slots + (size_t)(t & r->mask) * r->stride, r->stride);
+    atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+    return true;
+}
+
+//--------------------------- telemetry ----------------------
+// Fixed-size records go into one SPSC ring per producer thread; a
+// background writer drains them into rotating binary logs (telemetry.h).
+// Emitting is a bounds check and a 16-byte copy; a full ring drops.
+#define TELEM_RING            8192    // records per channel
+#define TELEM_FILE_BYTES      (4u << 20)
+#define TELEM_FILES           4       // rotation keeps this many logs
+
+enum { TELEM_SIM, TELEM_RENDER, TELEM_CHANNELS };
+
+typedef struct {
+    bool             enabled;
+    SpscRing         ring[TELEM_CHANNELS];
+    TelemetryRecord  slots[TELEM_CHANNELS][TELEM_RING];
+    uint32_t         stamp[TELEM_CHANNELS];   // owned by each producer
+    _Atomic uint32_t dropped;
+    const char      *prefix;
+    FILE            *file;
+    uint64_t         sequence;
+    size_t           file_bytes;
+    pthread_t        writer;
+    _Atomic bool     running;
+} Telemetry;
+
+static Telemetry telem;
+
+static void telemetry_stamp(int channel, uint32_t tick) {
+    telem.stamp[channel] = tick;
+}
+
+static void telemetry_emit(int channel, TelemetryKind kind, uint16_t a, float v0, uint32_t v1) {
+    if (!telem.enabled) return;
+    TelemetryRecord r = { telem.stamp[channel], (uint16_t)kind, a, v0, v1 };
+    if (!spsc_push(&telem.ring[channel], &r))
+        atomic_fetch_add_explicit(&telem.dropped, 1, memory_order_relaxed);
+}
+
+static void telemetry_open_next(Telemetry *t) {
+    if (t->file) fclose(t->file);
+    char path[512];
+    snprintf(path, sizeof(path), "%s.%d.bin", t->prefix, (int)(t->sequence % TELEM_FILES));
+    t->file = fopen(path, "wb");
+    t->file_bytes = 0;
+    if (!t->file) { TraceLog(LOG_WARNING, "TELEMETRY: cannot open %s", path); return; }
+    TelemetryHeader h = { .version = TELEM_VERSION, .record_size = sizeof(TelemetryRecord),
+                          .sim_hz = SIM_HZ, .sequence = t->sequence++ };
+    memcpy(h.magic, TELEM_MAGIC, 4);
+    t->file_bytes += fwrite(&h, 1, sizeof(h), t->file);
+}
+
+static void *telemetry_writer(void *arg) {
+    Telemetry *t = arg;
+    TelemetryRecord batch[512];
+    for (;;) {
+        bool running = atomic_load_explicit(&t->running, memory_order_acquire);
+        int n = 0;
+        for (int c = 0; c < TELEM_CHANNELS; ++c)
+            while (n < 512 && spsc_pop(&t->ring[c], &batch[n])) n++;
+        if (n && t->file) {
+            t->file_bytes += fwrite(batch, sizeof(TelemetryRecord), n, t->file) * sizeof(TelemetryRecord);
+            if (t->file_bytes >= TELEM_FILE_BYTES) telemetry_open_next(t);
+        }
+        if (n == 0) {
+            if (!running) break;          // drained after shutdown request
+            sleep_until(now_seconds() + 0.005);
+        }
+    }
+    if (t->file) { fclose(t->file); t->file = NULL; }
+    return NULL;
+}
+
+static void telemetry_start(const char *prefix) {
+    for (int c = 0; c < TELEM_CHANNELS; ++c)
+        spsc_init(&telem.ring[c], telem.slots[c], TELEM_RING, sizeof(TelemetryRecord));
+    telem.prefix = prefix;
+    telemetry_open_next(&telem);
+    atomic_store(&telem.running, true);
+    pthread_create(&telem.writer, NULL, telemetry_writer, &telem);
+    telem.enabled = true;
+}
+
+static void telemetry_stop(void) {
+    if (!telem.enabled) return;
+    telem.enabled = false;
+    atomic_store(&telem.running, false);
+    pthread_join(telem.writer, NULL);
+    uint32_t dropped = atomic_load(&telem.dropped);
+    if (dropped) TraceLog(LOG_WARNING, "TELEMETRY: dropped %u records", dropped);
+}
+
+//--------------------------- timing wheel -------------------
+// Hierarchical wheel keyed by tick: TW_LEVELS rings of TW_SLOTS buckets,
+// each level TW_SLOTS times coarser than the one below. Advancing a tick
+// touches one bucket (plus an occasional cascade), so the cost follows
+// the number of expirations rather than the number of live timers.
+#define TW_BITS               6
+#define TW_SLOTS              (1 << TW_BITS)
+#define TW_LEVELS             4       // 2^24 ticks of range
+#define TW_MAX_TIMERS         8192    // every script and bullet at once, see SCRIPT_MAX
+
+struct TimingWheel;
+typedef void (*TimerFn)(struct TimingWheel *tw, void *ctx, uint32_t arg);
+typedef uint32_t TimerId;             // generation << 16 | (index + 1); 0 = none
+
+typedef struct {
+    uint64_t expires;
+    TimerFn  fn;
+    void    *ctx;
+    uint32_t arg;
+    uint16_t gen;
+    int16_t  next, prev;              // bucket list, or free list via next
+    uint8_t  level, slot;
+} TwTimer;
+
+typedef struct TimingWheel {
+    uint64_t now;                     // last tick processed
+    int16_t  head[TW_LEVELS][TW_SLOTS];
+    int16_t  free_head;
+    bool     full_logged;             // warn about a full wheel once
+    TwTimer  t[TW_MAX_TIMERS];
+} TimingWheel;
+
+static inline uint64_t secs_to_ticks(float seconds) {
+    uint64_t n = (uint64_t)ceilf(seconds * SIM_HZ);
+    return n ? n : 1;
+}
+
+static void tw_init(TimingWheel *tw) {
+    tw->now = 0;
+    for (int l = 0; l < TW_LEVELS; ++l)
+        for (int s = 0; s < TW_SLOTS; ++s) tw->head[l][s] = -1;
+    for (int i = 0; i < TW_MAX_TIMERS; ++i) {
+        tw->t[i].next = (int16_t)(i + 1 < TW_MAX_TIMERS ? i + 1 : -1);
+        tw->t[i].gen  = 1;
+    }
+    tw->free_head = 0;
+    tw->full_logged = false;
+}
+
+static void tw_link(TimingWheel *tw, int16_t i) {
+    TwTimer *t = &tw->t[i];
+    uint64_t delta = t->expires > tw->now ? t->expires - tw->now : 0;
+    int level = 0;
+    while (level < TW_LEVELS - 1 && delta >= (1ull << (TW_BITS * (level + 1)))) level++;
+    t->level = (uint8_t)level;
+    t->slot  = (uint8_t)((t->expires >> (TW_BITS * level)) & (TW_SLOTS - 1));
+    int16_t *h = &tw->head[t->level][t->slot];
+    t->prev = -1;
+    t->next = *h;
+    if (*h >= 0) tw->t[*h].prev = i;
+    *h = i;
+}
+
+static void tw_unlink(TimingWheel *tw, int16_t i) {
+    TwTimer *t = &tw->t[i];
+    if (t->prev >= 0) tw->t[t->prev].next = t->next;
+    else              tw->head[t->level][t->slot] = t->next;
+    if (t->next >= 0) tw->t[t->next].prev = t->prev;
+}
+
+static void tw_release(TimingWheel *tw, int16_t i) {
+    tw->t[i].gen++;
+    tw->t[i].next = tw->free_head;
+    tw->free_head = i;
+}
+
+// Fires fn(tw, ctx, arg) once tick `at` is processed (at least next tick).
+static TimerId tw_schedule(TimingWheel *tw, uint64_t at, TimerFn fn, void *ctx, uint32_t arg) {
+    int16_t i = tw->free_head;
+    if (i < 0) {
+        if (!tw->full_logged) TraceLog(LOG_WARNING, "TIMERS: wheel full");
+        tw->full_logged = true;
+        return 0;
+    }
+    tw->free_head = tw->t[i].next;
+    TwTimer *t = &tw->t[i];
+    t->expires = at > tw->now ? at : tw->now + 1;
+    t->fn = fn; t->ctx = ctx; t->arg = arg;
+    tw_link(tw, i);
+    return (TimerId)t->gen << 16 | (TimerId)(i + 1);
+}
+
+static void tw_cancel(TimingWheel *tw, TimerId id) {
+    int16_t i = (int16_t)((id & 0xFFFF) - 1);
+    if (!id || i < 0 || i >= TW_MAX_TIMERS || tw->t[i].gen != (uint16_t)(id >> 16)) return;
+    tw_unlink(tw, i);
+    tw_release(tw, i);
+}
+
+static void tw_advance(TimingWheel *tw) {
+    tw->now++;
+    // pull the next block of each coarser level down when the finer one wraps
+    for (int l = 1; l < TW_LEVELS; ++l) {
+        if (tw->now & ((1ull << (TW_BITS * l)) - 1)) break;
+        int slot = (int)((tw->now >> (TW_BITS * l)) & (TW_SLOTS - 1));
+        int16_t i = tw->head[l][slot];
+        tw->head[l][slot] = -1;
+        while (i >= 0) {
+            int16_t next = tw->t[i].next;
+            tw_link(tw, i);
+            i = next;
+        }
+    }
+    // callbacks may schedule or cancel, so pop one timer at a time
+    int16_t *h = &tw->head[0][tw->now & (TW_SLOTS - 1)];
+    while (*h >= 0) {
+        int16_t i = *h;
+        TwTimer t = tw->t[i];
+        tw_unlink(tw, i);
+        tw_release(tw, i);
+        t.fn(tw, t.ctx, t.arg);
+    }
+}
+
+//--------------------------- scripts ------------------------
+// Stackless coroutines for gameplay scripts. A script is a function whose
+// body sits between SCRIPT_BEGIN and SCRIPT_END; every yield records the
+// line to resume at and returns, so anything that must survive a yield
+// lives in the Script itself. A sleeping script is one timer on the wheel
+// and a waiting one is a link in its event's list: neither is looked at
+// until its timer fires or the event is raised, so suspended scripts cost
+// nothing per tick. Events raised during a tick are delivered together by
+// script_dispatch, which keeps the order deterministic.
+#define SCRIPT_MAX            4096
+#define SCRIPT_DISPATCH_PASSES 4      // events raised by woken scripts
+
+// Sleeping scripts alone must not be able to starve bullet expiry or reload.
+_Static_assert(TW_MAX_TIMERS >= SCRIPT_MAX + BULLET_POOL + 64, "timing wheel too small");
+
+typedef enum {
+    SCRIPT_EV_KILL,                   // the number of live enemies went down
+    SCRIPT_EVENTS
+} ScriptEvent;
+
+typedef enum { SCRIPT_FREE, SCRIPT_RUNNING, SCRIPT_SLEEPING, SCRIPT_WAITING } ScriptState;
+
+struct Script;
+struct ScriptSched;
+// Runs until the next yield; returns false once the script has finished.
+typedef bool (*ScriptFn)(struct ScriptSched *sc, struct Script *s, void *ctx);
+
+typedef struct Script {
+    ScriptFn fn;
+    uint16_t line;                    // resume point, 0 = start
+    uint16_t gen;
+    int16_t  next;                    // event wait list, poll list or free list
+    uint8_t  state;
+    int      i, n;                    // locals that outlive a yield
+    uint64_t at;
+    uint64_t wake;                    // tick a sleep ends
+    uint32_t arg;
+} Script;
+
+typedef struct ScriptSched {
+    TimingWheel *tw;
+    void        *ctx;                 // handed to every script
+    uint32_t     raised;              // events pending delivery, one bit each
+    int16_t      waiters[SCRIPT_EVENTS];
+    int16_t      polling;             // sleepers the wheel had no room for
+    int16_t      free_head;
+    int          live;
+    Script       s[SCRIPT_MAX];
+} ScriptSched;
+
+#define SCRIPT_BEGIN(s)       switch ((s)->line) { case 0:
+#define SCRIPT_END(s)         } (void)(s); return false
+
+// Resumes after `ticks` ticks (at least one).
+#define SCRIPT_SLEEP(sc, s, ticks) \
+    do { script_sleep(sc, s, ticks); (s)->line = __LINE__; return true; case __LINE__:; } while (0)
+
+// Resumes once `cond` holds, re-checking it only when `ev` is raised.
+#define SCRIPT_WAIT_UNTIL(sc, s, ev, cond) \
+    do { (s)->line = __LINE__; __attribute__((fallthrough)); case __LINE__: \
+         if (!(cond)) { script_wait(sc, s, ev); return true; } } while (0)
+
+static void script_init(ScriptSched *sc, TimingWheel *tw, void *ctx) {
+    sc->tw = tw;
+    sc->ctx = ctx;
+    sc->raised = 0;
+    sc->live = 0;
+    for (int e = 0; e < SCRIPT_EVENTS; ++e) sc->waiters[e] = -1;
+    sc->polling = -1;
+    for (int i = 0; i < SCRIPT_MAX; ++i)
+        sc->s[i] = (Script){ .gen = 1, .next = (int16_t)(i + 1 < SCRIPT_MAX ? i + 1 : -1) };
+    sc->free_head = 0;
+}
+
+static void script_resume(ScriptSched *sc, int16_t i) {
+    Script *s = &sc->s[i];
+    s->state = SCRIPT_RUNNING;
+    if (s->fn(sc, s, sc->ctx)) return;
+    s->state = SCRIPT_FREE;
+    s->gen++;
+    s->next = sc->free_head;
+    sc->free_head = i;
+    sc->live--;
+}
+
+static void script_timer(TimingWheel *tw, void *ctx, uint32_t arg) {
+    ScriptSched *sc = ctx;
+    int16_t i = (int16_t)(arg & 0xFFFF);
+    if (sc->s[i].gen == (uint16_t)(arg >> 16) && sc->s[i].state == SCRIPT_SLEEPING)
+        script_resume(sc, i);
+}
+
+static void script_sleep(ScriptSched *sc, Script *s, uint64_t ticks) {
+    int16_t i = (int16_t)(s - sc->s);
+    s->state = SCRIPT_SLEEPING;
+    s->wake  = sc->tw->now + (ticks ? ticks : 1);
+    if (tw_schedule(sc->tw, s->wake, script_timer, sc, (uint32_t)s->gen << 16 | (uint32_t)i)) return;
+    // the wheel is full (tw_schedule has logged it): script_dispatch checks
+    // the wake tick every tick instead
+    s->next = sc->polling;
+    sc->polling = i;
+}
+
+static void script_wait(ScriptSched *sc, Script *s, ScriptEvent ev) {
+    s->state = SCRIPT_WAITING;
+    s->next = sc->waiters[ev];
+    sc->waiters[ev] = (int16_t)(s - sc->s);
+}
+
+// Starts `fn` right away; it runs up to its first yield before this returns.
+static bool script_start(ScriptSched *sc, ScriptFn fn, uint32_t arg) {
+    int16_t i = sc->free_head;
+    if (i < 0) { TraceLog(LOG_WARNING, "SCRIPTS: no free slot"); return false; }
+    Script *s = &sc->s[i];
+    sc->free_head = s->next;
+    *s = (Script){ .fn = fn, .gen = s->gen, .next = -1, .arg = arg };
+    sc->live++;
+    script_resume(sc, i);
+    return true;
+}
+
+static inline void script_raise(ScriptSched *sc, ScriptEvent ev) {
+    sc->raised |= 1u << ev;
+}
+
+// Call once per tick. Each waiter list is detached before it is walked, so a
+// script that waits again lands on the next delivery, not this one.
+static void script_dispatch(ScriptSched *sc) {
+    int16_t p = sc->polling;
+    sc->polling = -1;
+    while (p >= 0) {
+        int16_t next = sc->s[p].next;
+        if (sc->s[p].wake <= sc->tw->now) script_resume(sc, p);
+        else { sc->s[p].next = sc->polling; sc->polling = p; }
+        p = next;
+    }
+    for (int pass = 0; pass < SCRIPT_DISPATCH_PASSES && sc->raised; ++pass) {
+        uint32_t raised = sc->raised;
+        sc->raised = 0;
+        for (int e = 0; e < SCRIPT_EVENTS; ++e) {
+            if (!(raised & (1u << e))) continue;
+            int16_t i = sc->waiters[e];
+            sc->waiters[e] = -1;
+            while (i >= 0) {
+                int16_t next = sc->s[i].next;
+                script_resume(sc, i);
+                i = next;
+            }
+        }
+    }
+}
+
+//--------------------------- ecs ----------------------------
+// Archetype store. Every distinct component set gets its own table, split
+// into fixed-size chunks that hold one packed column per component, so a
+// query walks contiguous arrays of exactly the data it asked for. Spawns
+// and despawns are queued and applied by ecs_flush at the end of a tick:
+// nothing moves while systems iterate, and column pointers stay valid for
+// the whole tick. A new entity kind is a new component set, not a branch
+// in an existing loop.
+#define ECS_MAX_ENTITIES      (1 << 17)
+#define ECS_MAX_ARCHETYPES    8
+#define ECS_MAX_CHUNKS        256     // shared by all archetypes
+#define ECS_CHUNK_BYTES       16384
+#define ECS_MAX_SPAWNS        1024    // queued per tick
+#define ECS_ROW_MAX           96      // bytes of one staged entity
+
+typedef enum {
+    COMP_POS,                         // Vector2, top-left for enemies, centre otherwise
+    COMP_DIR,                         // Vector2, unit heading
+    COMP_SPEED,                       // float, px/s
+    COMP_HEALTH,                      // float
+    COMP_EXPIRY,                      // TimerId that despawns the entity
+    COMP_POWERUP,                     // PowerUp
+    COMP_QPOS,                        // QPos, compact COMP_POS
+    COMP_QDIR,                        // uint8_t heading, 256 steps per turn
+    COMP_QHEALTH,                     // uint16_t, share of the wave's max health
+    COMP_RANGED,                      // Ranged, enemies that shoot
+    COMP_ENEMY,                       // tag
+    COMP_BULLET,                      // tag
+    COMP_COUNT
+} Component;
+#define COMP(c)               (1u << (c))
+
+typedef uint32_t Entity;              // generation << 20 | (index + 1); 0 = none
+#define ECS_INDEX(e)          (((e) & 0xFFFFF) - 1)
+#define ECS_GEN(e)            ((e) >> 20)
+
+typedef enum { ECS_FREE, ECS_STAGED, ECS_LIVE, ECS_DYING, ECS_CANCELLED } EcsState;
+
+typedef struct {
+    uint16_t gen;
+    uint8_t  state;
+    uint8_t  arch;
+    uint32_t row;                     // table row, staged slot, or next free
+} EcsRecord;
+
+typedef struct {
+    uint32_t sig;
+    int      chunk_rows;              // rows per chunk
+    int      count;                   // live rows; every chunk but the last is full
+    int      chunk_count;
+    uint16_t col[COMP_COUNT];         // column offset inside a chunk, 0 = absent
+    uint16_t stage[COMP_COUNT];       // offset inside a staged row
+    uint16_t chunk[ECS_MAX_CHUNKS];
+} Archetype;
+
+typedef struct {
+    Entity   e;
+    uint8_t  arch;
+    uint8_t  row[ECS_ROW_MAX];
+} EcsSpawn;
+
+typedef struct {
+    uint16_t  size[COMP_COUNT];
+    int       arch_count, chunk_count;
+    Archetype arch[ECS_MAX_ARCHETYPES];
+    EcsRecord rec[ECS_MAX_ENTITIES];
+    uint32_t  free_head;
+    int       spawn_count, despawn_count;
+    EcsSpawn  spawn[ECS_MAX_SPAWNS];
+    Entity    despawn[ECS_MAX_ENTITIES];
+    uint8_t   mem[ECS_MAX_CHUNKS][ECS_CHUNK_BYTES];
+} Ecs;
+
+// Iterates every chunk of every archetype whose set contains `sig`:
+//   for (EcsQuery q = ecs_query(ecs, sig); ecs_next(&q);) { ... q.count rows ... }
+typedef struct {
+    const Ecs       *ecs;
+    uint32_t         sig;
+    int              arch, chunk;
+    int              count;
+    Entity          *entity;
+    uint8_t         *base;
+    const Archetype *a;
+} EcsQuery;
+
+#define ECS_COL(q, c, T)      ((T *)((q)->base + (q)->a->col[c]))
+#define ECS_GET(ecs, e, c, T) ((T *)ecs_get(ecs, e, c))
+
+static void ecs_init(Ecs *ecs, const uint16_t size[COMP_COUNT]) {
+    memcpy(ecs->size, size, sizeof(ecs->size));
+    ecs->arch_count = ecs->chunk_count = 0;
+    ecs->spawn_count = ecs->despawn_count = 0;
+    for (uint32_t i = 0; i < ECS_MAX_ENTITIES; ++i)
+        ecs->rec[i] = (EcsRecord){ .gen = 1, .state = ECS_FREE, .row = i + 1 };
+    ecs->free_head = 0;
+}
+
+static int ecs_archetype(Ecs *ecs, uint32_t sig) {
+    for (int i = 0; i < ecs->arch_count; ++i)
+        if (ecs->arch[i].sig == sig) return i;
+    if (ecs->arch_count == ECS_MAX_ARCHETYPES) return -1;
+    Archetype *a = &ecs->arch[ecs->arch_count];
+    *a = (Archetype){ .sig = sig };
+    int row = sizeof(Entity), staged = 0;
+    for (int c = 0; c < COMP_COUNT; ++c)
+        if (sig & COMP(c)) row += ecs->size[c];
+    a->chunk_rows = ECS_CHUNK_BYTES / row;
+    int off = a->chunk_rows * (int)sizeof(Entity);     // entity ids come first
+    for (int c = 0; c < COMP_COUNT; ++c) {
+        if (!(sig & COMP(c)) || !ecs->size[c]) continue;
+        a->col[c]   = (uint16_t)off;
+        a->stage[c] = (uint16_t)staged;
+        off    += a->chunk_rows * ecs->size[c];
+        staged += ecs->size[c];
+    }
+    if (staged > ECS_ROW_MAX) return -1;
+    return ecs->arch_count++;
+}
+
+static inline EcsRecord *ecs_record(const Ecs *ecs, Entity e) {
+    uint32_t i = ECS_INDEX(e);
+    if (!e || i >= ECS_MAX_ENTITIES || ecs->rec[i].gen != ECS_GEN(e)) return NULL;
+    return (EcsRecord *)&ecs->rec[i];
+}
+
+static inline bool ecs_alive(const Ecs *ecs, Entity e) {
+    const EcsRecord *r = ecs_record(ecs, e);
+    return r && r->state == ECS_LIVE;
+}
+
+// Queues a new entity; its components are written through ecs_get and it
+// joins queries after the next ecs_flush. Returns 0 when full.
+static Entity ecs_spawn(Ecs *ecs, uint32_t sig) {
+    int a = ecs_archetype(ecs, sig);
+    if (a < 0 || ecs->spawn_count == ECS_MAX_SPAWNS || ecs->free_head >= ECS_MAX_ENTITIES) {
+        TraceLog(LOG_WARNING, "ECS: cannot spawn 0x%x", sig);
+        return 0;
+    }
+    uint32_t i = ecs->free_head;
+    EcsRecord *r = &ecs->rec[i];
+    ecs->free_head = r->row;
+    Entity e = (Entity)r->gen << 20 | (i + 1);
+    r->state = ECS_STAGED;
+    r->arch  = (uint8_t)a;
+    r->row   = (uint32_t)ecs->spawn_count;
+    EcsSpawn *s = &ecs->spawn[ecs->spawn_count++];
+    s->e    = e;
+    s->arch = (uint8_t)a;
+    memset(s->row, 0, sizeof(s->row));
+    return e;
+}
+
+// Spawns that still fit in this tick's queue.
+static inline int ecs_spawn_room(const Ecs *ecs) {
+    return ECS_MAX_SPAWNS - ecs->spawn_count;
+}
+
+// Marks an entity for removal at the next ecs_flush. Stale ids are ignored.
+static void ecs_despawn(Ecs *ecs, Entity e) {
+    EcsRecord *r = ecs_record(ecs, e);
+    if (!r) return;
+    if (r->state == ECS_LIVE) {
+        r->state = ECS_DYING;
+        ecs->despawn[ecs->despawn_count++] = e;
+    } else if (r->state == ECS_STAGED) {
+        r->state = ECS_CANCELLED;     // dropped when its spawn is applied
+    }
+}
+
+static void *ecs_get(const Ecs *ecs, Entity e, Component c) {
+    const EcsRecord *r = ecs_record(ecs, e);
+    if (!r || r->state == ECS_FREE || r->state == ECS_CANCELLED) return NULL;
+    const Archetype *a = &ecs->arch[r->arch];
+    if (!(a->sig & COMP(c)) || !ecs->size[c]) return NULL;
+    if (r->state == ECS_STAGED)
+        return (uint8_t *)ecs->spawn[r->row].row + a->stage[c];
+    uint8_t *base = (uint8_t *)ecs->mem[a->chunk[r->row / a->chunk_rows]];
+    return base + a->col[c] + (r->row % a->chunk_rows) * ecs->size[c];
+}
+
+static inline uint8_t *ecs_chunk(Ecs *ecs, const Archetype *a, int row) {
+    return ecs->mem[a->chunk[row / a->chunk_rows]];
+}
+
+static void ecs_release(Ecs *ecs, Entity e) {
+    uint32_t i = ECS_INDEX(e);
+    ecs->rec[i].gen = (ecs->rec[i].gen + 1) & 0xFFF;
+    ecs->rec[i].state = ECS_FREE;
+    ecs->rec[i].row   = ecs->free_head;
+    ecs->free_head    = i;
+}
+
+// Despawns swap the table's last row into the hole; spawns append.
+static void ecs_flush(Ecs *ecs) {
+    for (int k = 0; k < ecs->despawn_count; ++k) {
+        Entity e = ecs->despawn[k];
+        EcsRecord *r = &ecs->rec[ECS_INDEX(e)];
+        Archetype *a = &ecs->arch[r->arch];
+        int row = (int)r->row, last = --a->count;
+        if (row != last) {
+            uint8_t *dst = ecs_chunk(ecs, a, row), *src = ecs_chunk(ecs, a, last);
+            int di = row % a->chunk_rows, si = last % a->chunk_rows;
+            for (int c = 0; c < COMP_COUNT; ++c) {
+                if (!a->col[c]) continue;
+                int sz = ecs->size[c];
+                memcpy(dst + a->col[c] + di * sz, src + a->col[c] + si * sz, sz);
+            }
+            Entity moved = ((Entity *)src)[si];
+            ((Entity *)dst)[di] = moved;
+            ecs->rec[ECS_INDEX(moved)].row = (uint32_t)row;
+        }
+        ecs_release(ecs, e);
+    }
+    ecs->despawn_count = 0;
+
+    for (int k = 0; k < ecs->spawn_count; ++k) {
+        EcsSpawn *s = &ecs->spawn[k];
+        EcsRecord *r = &ecs->rec[ECS_INDEX(s->e)];
+        if (r->state == ECS_CANCELLED) { ecs_release(ecs, s->e); continue; }
+        Archetype *a = &ecs->arch[s->arch];
+        if (a->count == a->chunk_count * a->chunk_rows) {
+            if (ecs->chunk_count == ECS_MAX_CHUNKS) {
+                TraceLog(LOG_WARNING, "ECS: out of chunks");
+                ecs_release(ecs, s->e);
+                continue;
+            }
+            a->chunk[a->chunk_count++] = (uint16_t)ecs->chunk_count++;
         }
+        int row = a->count++, ri = row % a->chunk_rows;
+        uint8_t *dst = ecs_chunk(ecs, a, row);
+        ((Entity *)dst)[ri] = s->e;
+        for (int c = 0; c < COMP_COUNT; ++c)
+            if (a->col[c]) memcpy(dst + a->col[c] + ri * ecs->size[c], s->row + a->stage[c], ecs->size[c]);
+        r->state = ECS_LIVE;
+        r->row   = (uint32_t)row;
     }
+    ecs->spawn_count = 0;
 }
 
-static void bullet_update(Bullet *b, float dt) {
-    b->pos = v2_scale_add(b->pos, b->speed * dt, b->dir);
-    b->lifeTimer += dt;
-    if (b->lifeTimer > b->lifespan) b->active = false;
+static EcsQuery ecs_query(const Ecs *ecs, uint32_t sig) {
+    return (EcsQuery){ .ecs = ecs, .sig = sig, .arch = 0, .chunk = -1 };
 }
 
-static void bullet_draw(const Bullet *b) {
-    DrawCircleV(b->pos, BULLET_RADIUS, BLACK);
+static bool ecs_next(EcsQuery *q) {
+    const Ecs *ecs = q->ecs;
+    for (; q->arch < ecs->arch_count; q->arch++, q->chunk = -1) {
+        const Archetype *a = &ecs->arch[q->arch];
+        if ((a->sig & q->sig) != q->sig) continue;
+        int rows = a->count - ++q->chunk * a->chunk_rows;
+        if (rows <= 0) continue;
+        q->a      = a;
+        q->count  = rows < a->chunk_rows ? rows : a->chunk_rows;
+        q->base   = (uint8_t *)ecs->mem[a->chunk[q->chunk]];
+        q->entity = (Entity *)q->base;
+        return true;
+    }
+    return false;
+}
+
+// bytes one entity of this exact set occupies in its chunk, id included
+static int ecs_row_bytes(const Ecs *ecs, uint32_t sig) {
+    int n = sizeof(Entity);
+    for (int c = 0; c < COMP_COUNT; ++c)
+        if (sig & COMP(c)) n += ecs->size[c];
+    return n;
+}
+
+static int ecs_count(const Ecs *ecs, uint32_t sig) {
+    int n = 0;
+    for (int i = 0; i < ecs->arch_count; ++i)
+        if ((ecs->arch[i].sig & sig) == sig) n += ecs->arch[i].count;
+    return n;
+}
+
+//--------------------------- bullets ------------------------
+#define BULLET_SIG      (COMP(COMP_POS) | COMP(COMP_DIR) | COMP(COMP_SPEED) | COMP(COMP_EXPIRY) | COMP(COMP_BULLET))
+#define BULLET_SPEED    1000.0f
+#define BULLET_LIFESPAN 0.4f
+
+static void bullet_expire(TimingWheel *tw, void *ctx, uint32_t e) {
+    *ECS_GET(ctx, e, COMP_EXPIRY, TimerId) = 0;
+    ecs_despawn(ctx, e);
+}
+
+static void bullet_spawn(Ecs *ecs, TimingWheel *tw, Vector2 pos, Vector2 dir) {
+    if (ecs_count(ecs, BULLET_SIG) >= BULLET_POOL) return;
+    Entity e = ecs_spawn(ecs, BULLET_SIG);
+    if (!e) return;
+    *ECS_GET(ecs, e, COMP_POS, Vector2)   = pos;
+    *ECS_GET(ecs, e, COMP_DIR, Vector2)   = dir;
+    *ECS_GET(ecs, e, COMP_SPEED, float)   = BULLET_SPEED;
+    TimerId expiry = tw_schedule(tw, tw->now + secs_to_ticks(BULLET_LIFESPAN), bullet_expire, ecs, e);
+    *ECS_GET(ecs, e, COMP_EXPIRY, TimerId) = expiry;
+    if (!expiry) ecs_despawn(ecs, e);    // a bullet that never expires would jam the pool
+}
+
+// A bullet that hits something dies early; drop its pending expiry.
+// A zero expiry also tells the rest of the tick the bullet is spent.
+static void bullet_kill(Ecs *ecs, TimingWheel *tw, Entity e, TimerId *expiry) {
+    tw_cancel(tw, *expiry);
+    *expiry = 0;
+    ecs_despawn(ecs, e);
+}
+
+static void bullet_update(Ecs *ecs, float dt) {
+    for (EcsQuery q = ecs_query(ecs, BULLET_SIG); ecs_next(&q);) {
+        Vector2 *pos = ECS_COL(&q, COMP_POS, Vector2);
+        Vector2 *dir = ECS_COL(&q, COMP_DIR, Vector2);
+        float   *spd = ECS_COL(&q, COMP_SPEED, float);
+        for (int i = 0; i < q.count; ++i) pos[i] = v2_scale_add(pos[i], spd[i] * dt, dir[i]);
+    }
 }
 
+
 //--------------------------- weapon -------------------------
 typedef struct {
     float  spread;       // radians
@@ -78,12 +848,10 @@ typedef struct {
     float  reloadTime;   // seconds/mag
     int    max_rounds;
 
-    float  fireTimer;
-    float  reloadTimer;
+    uint64_t readyTick;  // earliest tick the next shot may leave
     int    ammo;
     bool reloading;
     float damage;
-    Bullet bullets[BULLET_POOL];
 } Weapon;
 
 static void weapon_init(Weapon *w) {
@@ -95,47 +863,41 @@ static void weapon_init(Weapon *w) {
         .ammo        = 100,
         .damage      = 150
     };
-    bullet_pool_init(w->bullets);
+    w->readyTick = secs_to_ticks(w->fireRate);
 }
 
 static Vector2 weapon_apply_spread(const Weapon *w, Vector2 dir) {
     return Vector2Rotate(dir, randf(-w->spread, w->spread));
 }
 
-static void weapon_update(Weapon *w, Vector2 muzzle, float dt) {
-    bool want_fire = IsMouseButtonDown(MOUSE_BUTTON_LEFT);
+static void weapon_reloaded(TimingWheel *tw, void *ctx, uint32_t arg) {
+    Weapon *w = ctx;
+    w->ammo      = w->max_rounds;
+    w->reloading = 0;
+}
 
-    // timers
-    w->fireTimer   += dt;
-    if (!w->ammo)  w->reloadTimer += dt;
+static void weapon_update(Weapon *w, Ecs *ecs, Vector2 muzzle, const InputFrame *in,
+                          const InputLatch *latch, TimingWheel *tw) {
+    bool want_fire = in->fire;
 
-    // reload finished?
-    if (!w->ammo && w->reloadTimer > w->reloadTime) {
-        w->ammo        = w->max_rounds;
-        w->reloadTimer = 0;
-        w->reloading=0;
-    }
-    if(w->ammo==0 && w->reloadTimer<=w->reloadTime){
-        w->reloading=1;
-    }
     // try to shoot
-    if (want_fire && w->ammo && w->fireTimer > w->fireRate) {
-        Vector2 mouse = GetMousePosition();
-        Vector2 dir   = weapon_apply_spread(w, Vector2Normalize(Vector2Subtract(mouse, muzzle)));
-        bullet_spawn(w->bullets, muzzle, dir);
+    if (want_fire && w->ammo && tw->now >= w->readyTick) {
+        if (latch->fn) in = latch->fn(latch->ctx);     // aim with the newest mouse
+        Vector2 dir   = weapon_apply_spread(w, Vector2Normalize(Vector2Subtract(in->mouse, muzzle)));
+        bullet_spawn(ecs, tw, muzzle, dir);
         PlaySound(shooting_sound);
         w->ammo--;
-        w->fireTimer = 0;
+        w->readyTick = tw->now + secs_to_ticks(w->fireRate);
+        if (!w->ammo) {
+            w->reloading = 1;
+            uint64_t done = tw->now + secs_to_ticks(w->reloadTime);
+            if (!tw_schedule(tw, done, weapon_reloaded, w, 0)) {
+                // no timer: refill now and hold the next shot for the reload instead
+                weapon_reloaded(tw, w, 0);
+                w->readyTick = done;
+            }
+        }
     }
-
-    // update bullets
-    for (int i = 0; i < BULLET_POOL; ++i)
-        if (w->bullets[i].active) bullet_update(&w->bullets[i], dt);
-}
-
-static void weapon_draw(const Weapon *w) {
-    for (int i = 0; i < BULLET_POOL; ++i)
-        if (w->bullets[i].active) bullet_draw(&w->bullets[i]);
 }
 //PowerUps
 
@@ -156,7 +918,6 @@ typedef enum{
 }Rarity;
 
 typedef struct {
-    Vector2 pos;
     PowerUpType type;
     Rarity rarity;
     float health_factor;
@@ -166,16 +927,16 @@ typedef struct {
     float damage_factor;
     Color color;
     int size;
-    int active;
 } PowerUp;
-static void set_powerup(PowerUp* powerup){
-    powerup->active = 1;
-    int rarity = rand()%100;
+#define POWERUP_SIG (COMP(COMP_POS) | COMP(COMP_POWERUP))
+
+static void set_powerup(PowerUp* powerup, Vector2* pos){
+    int rarity = rng_range(0,99);
     if(rarity<50) powerup->rarity=COMMON;
     else if(rarity>50&&rarity<80) powerup->rarity=UNCOMMON;
     else powerup->rarity=RARE;
-    powerup->type = rand()%5;
-    powerup->pos = (Vector2){GetRandomValue(0,GetScreenWidth()),GetRandomValue(0,GetScreenHeight())};
+    powerup->type = rng_range(0,4);
+    *pos = (Vector2){rng_range(0,ARENA_W),rng_range(0,ARENA_H)};
     switch(powerup->rarity){
         case COMMON:
             powerup->health_factor = 1.1f;
@@ -246,6 +1007,12 @@ static void set_powerup(PowerUp* powerup){
 
 }
 
+static Entity powerup_spawn(Ecs *ecs) {
+    Entity e = ecs_spawn(ecs, POWERUP_SIG);
+    if (e) set_powerup(ECS_GET(ecs, e, COMP_POWERUP, PowerUp), ECS_GET(ecs, e, COMP_POS, Vector2));
+    return e;
+}
+
 //--------------------------- player -------------------------
 typedef struct {
     Vector2 pos, vel;
@@ -257,58 +1024,59 @@ typedef struct {
 } Player;
 
 static void player_init(Player *p) {
-    *p = (Player){ .pos = {SCR_W/2.0f, SCR_H/2.0f},
+    *p = (Player){ .pos = {ARENA_W/2.0f, ARENA_H/2.0f},
                    .speed = 200.0f, .health = 100.0f,.max_health=100.0f,
                     .collider=(Rectangle){0,0,PLAYER_SIZE,PLAYER_SIZE} };
     weapon_init(&p->gun);
 }
 
-static void player_update(Player *p, float dt) {
+static void player_update(Player *p, Ecs *ecs, const InputFrame *in, const InputLatch *latch,
+                          TimingWheel *tw, float dt) {
     p->collider.x = p->pos.x; p->collider.y = p->pos.y;
-    Vector2 dir = { 0 };
-    if (IsKeyDown(KEY_W)) dir.y -= 1;
-    if (IsKeyDown(KEY_S)) dir.y += 1;
-    if (IsKeyDown(KEY_A)) dir.x -= 1;
-    if (IsKeyDown(KEY_D)) dir.x += 1;
-
-    dir = Vector2Normalize(dir);
+    Vector2 dir = Vector2Normalize(in->move);
     p->pos = v2_scale_add(p->pos, p->speed * dt, dir);
 
-    weapon_update(&p->gun, p->pos, dt);
-}
-
-static void player_draw(const Player *p) {
-    DrawRectangleV(
-        (Vector2){ p->pos.x - PLAYER_SIZE/2, p->pos.y - PLAYER_SIZE/2 },
-        (Vector2){ PLAYER_SIZE, PLAYER_SIZE },
-        BLACK);
-    weapon_draw(&p->gun);
+    weapon_update(&p->gun, ecs, p->pos, in, latch, tw);
 }
 static void player_limit_movement(Player *p) {
-    p->pos = clamp_v2(p->pos,(Vector2){0,0},(Vector2){SCR_W,SCR_H});
+    p->pos = clamp_v2(p->pos,(Vector2){0,0},(Vector2){ARENA_W,ARENA_H});
 }
 //--------------------------- enemies ------------------------
-typedef struct{
-    Vector2 position;
-    float radius;
-}Circle;
+// Enemy variants add components next to the COMP_ENEMY tag; systems that
+// only need these columns keep iterating them untouched.
+#define ENEMY_SIG   (COMP(COMP_POS) | COMP(COMP_DIR) | COMP(COMP_SPEED) | COMP(COMP_HEALTH) | COMP(COMP_ENEMY))
+
+// Compact layout: 1/64 px fixed-point position clamped to the arena, an
+// 8-bit heading and health as a 16-bit share of the wave's max_health.
+// Speed is the wave's max_speed, so it is not stored at all.
+#define ENEMY_Q_SIG (COMP(COMP_QPOS) | COMP(COMP_QDIR) | COMP(COMP_QHEALTH) | COMP(COMP_ENEMY))
+#define QPOS_SHIFT  6
+#define QPOS_ONE    (1 << QPOS_SHIFT)
+#define QHEALTH_MAX 0xFFFF
+
+typedef struct { uint16_t x, y; } QPos;
+
+static bool compact_enemies;     // layout for new worlds, --compact
+
+// Shooters are chasers with a Ranged next to their position, so every
+// enemy system keeps treating them as plain enemies.
+#define RANGED_FIRST_WAVE 2      // default waves: from here on
+#define RANGED_ONE_IN     5      // every 5th spawn shoots
 
 typedef struct {
-    bool     active;
-    Vector2  pos, vel;
-    Vector2  dir;
-    float    speed;
-    float    health;
-    Rectangle collider;
-    Circle    areaCollider;
-    bool     self_colliding;
-   
-} Enemy;
+    uint8_t  pattern;            // WAVE_RING, WAVE_SPIRAL or WAVE_AIMED
+    uint8_t  volleys;            // fired so far, turns spirals
+    uint32_t due;                // tick of the next volley, 0 = not armed yet
+} Ranged;
+
+static inline uint16_t qpos_encode(float v) {
+    return (uint16_t)CLAMP((int)(v * QPOS_ONE + 0.5f), 0, 0xFFFF);
+}
 
 typedef struct {
-    Enemy    e[ENEMY_POOL];
+    Ecs     *ecs;
     Vector2  spawner[SPAWN_POINTS];
-    float    spawnTimer, spawnRate;
+    float    spawnRate;
     int      alive;
     int      wave;
     int      max_per_wave;
@@ -316,192 +1084,2046 @@ typedef struct {
     float    max_speed;
     
     float total_enemies;
-    float waveTimer;
+    uint64_t waveDue;    // tick the pending wave starts
     float waveDelay;
-    bool  wavePending;
+    bool  wavePending;   // between waves; set by the wave script
     float    damage;
+    bool     compact;    // spawn ENEMY_Q_SIG instead of ENEMY_SIG
+    int16_t  qcos[256], qsin[256];
 
 } EnemyManager;
 
-static void enemy_manager_init(EnemyManager *em) {
+static void enemy_manager_init(EnemyManager *em, Ecs *ecs) {
     *em = (EnemyManager){
+        .ecs           = ecs,
         .spawnRate     = 2.0f,
         .max_per_wave  = 4,
         .max_health    = 200.0f,
         .max_speed     = 100.0f,
         .total_enemies = 0.0f,
         .waveDelay     = 5.0f,
-        .damage        = 10.0f
+        .damage        = 10.0f,
+        .compact       = compact_enemies
     };
-
-    for (int i = 0; i < ENEMY_POOL; ++i)
-        em->e[i].active = false;
+    for (int a = 0; a < 256; ++a) {
+        em->qcos[a] = (int16_t)lrintf(cosf(a * (2 * PI / 256)) * 16384);
+        em->qsin[a] = (int16_t)lrintf(sinf(a * (2 * PI / 256)) * 16384);
+    }
 
     // 4 corners + mid‑edges
     em->spawner[0] = (Vector2){0,0};
-    em->spawner[1] = (Vector2){SCR_W,0};
-    em->spawner[2] = (Vector2){0,SCR_H};
-    em->spawner[3] = (Vector2){SCR_W,SCR_H};
-    em->spawner[4] = (Vector2){SCR_W/2,0};
-    em->spawner[5] = (Vector2){SCR_W/2,SCR_H};
-    em->spawner[6] = (Vector2){0,SCR_H/2};
-    em->spawner[7] = (Vector2){SCR_W,SCR_H/2};
+    em->spawner[1] = (Vector2){ARENA_W,0};
+    em->spawner[2] = (Vector2){0,ARENA_H};
+    em->spawner[3] = (Vector2){ARENA_W,ARENA_H};
+    em->spawner[4] = (Vector2){ARENA_W/2,0};
+    em->spawner[5] = (Vector2){ARENA_W/2,ARENA_H};
+    em->spawner[6] = (Vector2){0,ARENA_H/2};
+    em->spawner[7] = (Vector2){ARENA_W,ARENA_H/2};
+}
+
+// Clears the field for em->wave, whose parameters the caller has set.
+static void enemy_wave_begin(EnemyManager *em, uint32_t kills) {
+    em->wavePending  = false;
+    telemetry_emit(TELEM_SIM, TELEM_WAVE, (uint16_t)em->wave, em->spawnRate, kills);
+    em->total_enemies =0;
+    em->alive = 0;
+    for (EcsQuery q = ecs_query(em->ecs, COMP(COMP_ENEMY)); ecs_next(&q);)
+        for (int i = 0; i < q.count; ++i) ecs_despawn(em->ecs, q.entity[i]);
 }
 
 static void enemy_wave_next(EnemyManager *em) {
+    uint32_t kills = (uint32_t)(em->total_enemies - em->alive);
     em->wave++;
-    em->waveTimer    = 0;
-    em->wavePending  = false;
     em->spawnRate   *= expf(-0.04f * em->wave);
     em->max_health  *= expf(0.01f * em->wave);
     em->max_speed   *= expf(0.005f * em->wave);
     em->max_per_wave= (int)(em->max_per_wave * expf(0.05f * em->wave));
-    em->total_enemies =0;
-    em->alive = 0;
-    for (int i = 0; i < ENEMY_POOL; ++i)
-        em->e[i].active = false;
+    enemy_wave_begin(em, kills);
 }
-static void enemy_wave_update(EnemyManager *em, float dt) {
-    if (em->alive == 0 && em->wavePending == false && em->total_enemies>=em->max_per_wave) {
-        em->wavePending = true;
-        em->waveTimer   = 0;
-    }
 
-    if (em->wavePending) {
-        em->waveTimer += GetFrameTime();
-        if (em->waveTimer >= em->waveDelay) {
-            enemy_wave_next(em);
-        }
+// The compact layout stores health relative to max_health and moves at
+// max_speed, so there hp is capped and speed ignored. `type` is a WAVE_*.
+static bool enemy_add_stats(EnemyManager *em, Vector2 pos, float hp, float speed, int type) {
+    if (em->alive >= ENEMY_POOL) return false;
+    uint32_t sig = em->compact ? ENEMY_Q_SIG : ENEMY_SIG;
+    bool ranged = type > WAVE_CHASER && type < WAVE_TYPES;
+    Entity e = ecs_spawn(em->ecs, ranged ? sig | COMP(COMP_RANGED) : sig);
+    if (!e) return false;
+    if (ranged) *ECS_GET(em->ecs, e, COMP_RANGED, Ranged) = (Ranged){ .pattern = (uint8_t)type };
+    if (em->compact) {
+        *ECS_GET(em->ecs, e, COMP_QPOS, QPos)        = (QPos){ qpos_encode(pos.x), qpos_encode(pos.y) };
+        *ECS_GET(em->ecs, e, COMP_QHEALTH, uint16_t) =
+            (uint16_t)CLAMP((int)ceilf(hp / em->max_health * QHEALTH_MAX), 1, QHEALTH_MAX);
+    } else {
+        *ECS_GET(em->ecs, e, COMP_POS, Vector2) = pos;
+        *ECS_GET(em->ecs, e, COMP_SPEED, float) = speed;
+        *ECS_GET(em->ecs, e, COMP_HEALTH, float) = hp;
     }
+    em->alive++;
+    em->total_enemies++;
+    return true;
 }
 
-
+static bool enemy_add(EnemyManager *em, Vector2 pos) {
+    return enemy_add_stats(em, pos, em->max_health, em->max_speed, WAVE_CHASER);
+}
 
 static void enemy_spawn(EnemyManager *em) {
     if (em->alive >= em->max_per_wave) return;
     if (em->total_enemies>=em->max_per_wave)return;
-    for (int i = 0; i < ENEMY_POOL; ++i) {
-        Enemy *e = &em->e[i];
-        if (!e->active) {
-            *e = (Enemy){
-                .active  = true,
-                .pos     = em->spawner[rand() % SPAWN_POINTS],
-                .speed   = em->max_speed,
-                .health  = em->max_health,
-                .collider= {0,0,10,10}
-            };
-            em->alive++;
-            em->total_enemies++;
-            break;
-        }
-    }
+    int type = WAVE_CHASER;
+    if (em->wave >= RANGED_FIRST_WAVE && (int)em->total_enemies % RANGED_ONE_IN == RANGED_ONE_IN - 1)
+        type = WAVE_RING + (int)(rng_u32() % (WAVE_TYPES - WAVE_RING));
+    enemy_add_stats(em, em->spawner[rng_u32() % SPAWN_POINTS], em->max_health, em->max_speed, type);
 }
 
-static void enemy_update(Enemy *e, const Player *p, float dt) {
-    // Vector2 dir = (Vector2){ 0,0 };
-    if(!e->self_colliding){
-        e->dir= Vector2Normalize(Vector2Subtract(p->pos, e->pos));
-    }else{
-        
+//--------------------------- crowd steering -----------------
+// Seek + optional alignment, then a fixed number of position-based
+// relaxation passes over per-frame neighbour lists. Cost is bounded by
+// ENEMY_POOL * CROWD_MAX_NEIGHBOURS * CROWD_ITERATIONS pair checks.
+//
+// Level of detail: within LOD_BAND of the target an agent steps every
+// tick; each further band halves its rate, down to every 8th tick, with
+// dt scaled to match. Agents are staggered by entity index so every tick
+// carries the same share of each band. Agents that sit a tick out still
+// take part in the grid as obstacles, they just do not move.
+#define CROWD_SPACING         10.0f   // min distance between enemy centres
+#define CROWD_NEIGHBOUR_RANGE 15.0f   // gather radius (spacing + movement slack)
+#define CROWD_CELL            15      // >= CROWD_NEIGHBOUR_RANGE
+#define CROWD_GRID_W          (ARENA_W / CROWD_CELL + 1)
+#define CROWD_GRID_H          (ARENA_H / CROWD_CELL + 1)
+#define CROWD_MAX_NEIGHBOURS  8
+#define CROWD_MAX_CANDIDATES  24      // cap on agents scanned per gather
+#define CROWD_ITERATIONS      2
+#define CROWD_RELAX           1.0f    // scale on the summed correction per pass
+#define CROWD_ALIGNMENT       0.2f    // weight of neighbour heading, 0 = off
+#define LOD_BAND              150.0f  // px per level of detail
+#define LOD_LEVELS            4       // every 1, 2, 4, 8 ticks
+
+typedef struct {
+    float    alignment;               // 0 disables alignment
+    int      separate_every;          // ticks per separation pass, 1 = every tick, 0 = off
+    uint32_t phase;
+    bool     lod;                     // false = every agent every tick
+    uint32_t tick;
+    int      count;
+    int      active;                  // agents stepped this tick, listed in act[]
+    uint32_t act[ENEMY_POOL];
+    float    step[ENEMY_POOL];        // dt of each act[] entry
+    uint8_t  slot[ENEMY_POOL];        // stagger offset
+    float    speed[ENEMY_POOL];
+    Vector2  p[ENEMY_POOL];
+    Vector2  dir[ENEMY_POOL];
+    Vector2  corr[ENEMY_POOL];
+    int      cell_start[CROWD_GRID_W * CROWD_GRID_H + 1];
+    int      cell_fill[CROWD_GRID_W * CROWD_GRID_H];
+    uint32_t cell_items[ENEMY_POOL];
+    uint16_t cell_of[ENEMY_POOL];
+    uint8_t  nbr_count[ENEMY_POOL];
+    uint32_t nbr[ENEMY_POOL][CROWD_MAX_NEIGHBOURS];
+} Crowd;
+
+static inline int crowd_cell(Vector2 p) {
+    int cx = CLAMP((int)(p.x / (float)CROWD_CELL), 0, CROWD_GRID_W - 1);
+    int cy = CLAMP((int)(p.y / (float)CROWD_CELL), 0, CROWD_GRID_H - 1);
+    return cy * CROWD_GRID_W + cx;
+}
+
+static void crowd_build_grid(Crowd *c) {
+    const int cells = CROWD_GRID_W * CROWD_GRID_H;
+    memset(c->cell_start, 0, sizeof(c->cell_start));
+    for (int i = 0; i < c->count; ++i) {
+        c->cell_of[i] = (uint16_t)crowd_cell(c->p[i]);
+        c->cell_start[c->cell_of[i] + 1]++;
     }
-    e->pos      = v2_scale_add(e->pos, e->speed * dt, e->dir);
-    e->collider.x = e->pos.x; e->collider.y = e->pos.y;
+    for (int k = 0; k < cells; ++k) c->cell_start[k + 1] += c->cell_start[k];
+    int *fill = c->cell_fill;
+    memcpy(fill, c->cell_start, sizeof(c->cell_fill));
+    for (int i = 0; i < c->count; ++i) c->cell_items[fill[c->cell_of[i]]++] = (uint32_t)i;
 }
-static void enemy_moveaway(Enemy *e1,Enemy *e2){
-    e1->dir= Vector2Normalize(Vector2Subtract(e2->pos, e1->pos));
-    e1->pos      = v2_scale_add(e1->pos, -e1->speed * GetFrameTime(), e1->dir);
-    e1->collider.x = e1->pos.x; e1->collider.y = e1->pos.y;
+
+static const int crowd_probe[9][2] = {
+    {0,0},{-1,0},{1,0},{0,-1},{0,1},{-1,-1},{1,-1},{-1,1},{1,1}
+};
+
+// keeps the CROWD_MAX_NEIGHBOURS closest agents within range
+static void crowd_gather_neighbours(Crowd *c) {
+    const float r2 = CROWD_NEIGHBOUR_RANGE * CROWD_NEIGHBOUR_RANGE;
+    float best[CROWD_MAX_NEIGHBOURS];
+    for (int a = 0; a < c->active; ++a) {
+        int i = (int)c->act[a];
+        int cx = c->cell_of[i] % CROWD_GRID_W, cy = c->cell_of[i] / CROWD_GRID_W;
+        int n = 0, budget = CROWD_MAX_CANDIDATES;
+        for (int o = 0; o < 9 && budget; ++o) {   // own cell first
+            int x = cx + crowd_probe[o][0], y = cy + crowd_probe[o][1];
+            if (x < 0 || x >= CROWD_GRID_W || y < 0 || y >= CROWD_GRID_H) continue;
+            int cell = y * CROWD_GRID_W + x;
+            for (int k = c->cell_start[cell]; k < c->cell_start[cell + 1] && budget; ++k, --budget) {
+                int j = c->cell_items[k];
+                if (j == i) continue;
+                float dx = c->p[j].x - c->p[i].x, dy = c->p[j].y - c->p[i].y;
+                float d2 = dx*dx + dy*dy;
+                if (d2 > r2) continue;
+                if (n == CROWD_MAX_NEIGHBOURS && d2 >= best[n - 1]) continue;
+                int m = (n < CROWD_MAX_NEIGHBOURS) ? n++ : n - 1;
+                while (m > 0 && best[m - 1] > d2) {
+                    best[m] = best[m - 1]; c->nbr[i][m] = c->nbr[i][m - 1]; --m;
+                }
+                best[m] = d2; c->nbr[i][m] = (uint32_t)j;
+            }
+        }
+        c->nbr_count[i] = (uint8_t)n;
+    }
 }
-static void enemy_selfcollide(Enemy *e1,Enemy *e2){
-    if(CheckCollisionCircles(e1->pos,10,e2->pos,10)){
-        e1->self_colliding=true;
-        e2->self_colliding=true;
-        enemy_moveaway(e1,e2);
-    }else{
-        e1->self_colliding=false;
-        e2->self_colliding=false;
+
+// Jacobi pass: corrections are computed from the previous positions and
+// applied together, so the result does not depend on iteration order.
+static void crowd_relax(Crowd *c) {
+    const float d0 = CROWD_SPACING, d02 = d0 * d0;
+    for (int a = 0; a < c->active; ++a) {
+        int i = (int)c->act[a];
+        Vector2 acc = { 0 };
+        for (int k = 0; k < c->nbr_count[i]; ++k) {
+            int j = c->nbr[i][k];
+            float dx = c->p[i].x - c->p[j].x, dy = c->p[i].y - c->p[j].y;
+            float d2 = dx*dx + dy*dy;
+            if (d2 >= d02) continue;
+            if (d2 < 1e-8f) {                      // coincident: split on index
+                acc.x += (i < j ? 0.5f : -0.5f) * d0;
+            } else {
+                float d = sqrtf(d2), s = (d0 - d) * 0.5f / d;
+                acc.x += dx * s; acc.y += dy * s;
+            }
+        }
+        c->corr[i] = acc;
+    }
+    for (int a = 0; a < c->active; ++a) {
+        int i = (int)c->act[a];
+        c->p[i].x += c->corr[i].x * CROWD_RELAX;
+        c->p[i].y += c->corr[i].y * CROWD_RELAX;
     }
 }
-static void attack(EnemyManager *e,int index,Player *p){
-    if(!e->e[index].active)return;
-    if(CheckCollisionRecs(p->collider,e->e[index].collider)){
-        p->health-=e->damage;
-        e->e[index].active=false;
-        e->alive--;
-        PlaySound(hit_sound);
+
+// Picks the agents that step this tick and their dt.
+static void crowd_schedule(Crowd *c, Vector2 target, float dt) {
+    const float band2 = LOD_BAND * LOD_BAND;
+    c->tick++;
+    c->active = 0;
+    if (!c->lod) {
+        for (int i = 0; i < c->count; ++i) { c->act[i] = (uint32_t)i; c->step[i] = dt; }
+        c->active = c->count;
+        return;
     }
+    // branch-free: every agent is written, only due ones advance the cursor
+    for (int i = 0; i < c->count; ++i) {
+        float dx = c->p[i].x - target.x, dy = c->p[i].y - target.y, d2 = dx*dx + dy*dy;
+        int level = (d2 >= band2) + (d2 >= 4 * band2) + (d2 >= 9 * band2);
+        uint32_t period = 1u << level;
+        c->act[c->active]  = (uint32_t)i;
+        c->step[c->active] = dt * period;
+        c->active += ((c->tick + c->slot[i]) & (period - 1)) == 0;
+    }
+}
+
+static void crowd_activate_all(Crowd *c) {
+    for (int i = 0; i < c->count; ++i) c->act[i] = (uint32_t)i;
+    c->active = c->count;
 }
 
+static bool crowd_separation_due(Crowd *c) {
+    if (c->separate_every <= 0) return false;
+    return c->separate_every == 1 || c->phase++ % c->separate_every == 0;
+}
 
-static void enemy_manager_update(EnemyManager *em, const Player *p, float dt) {
-    // spawn logic
-    em->spawnTimer += dt;
-    if (em->spawnTimer > em->spawnRate) {
-        em->spawnTimer = 0;
-        enemy_spawn(em);
+// Agents are numbered in query order; no structural change happens before
+// the write-back walks the same chunks again.
+static void crowd_steer(Crowd *c, Ecs *ecs, Vector2 target, float dt) {
+    c->count = 0;
+    for (EcsQuery q = ecs_query(ecs, ENEMY_SIG); ecs_next(&q);) {
+        int n = q.count < ENEMY_POOL - c->count ? q.count : ENEMY_POOL - c->count;
+        memcpy(&c->p[c->count],     ECS_COL(&q, COMP_POS, Vector2), n * sizeof(Vector2));
+        memcpy(&c->dir[c->count],   ECS_COL(&q, COMP_DIR, Vector2), n * sizeof(Vector2));
+        memcpy(&c->speed[c->count], ECS_COL(&q, COMP_SPEED, float), n * sizeof(float));
+        for (int i = 0; i < n; ++i) c->slot[c->count + i] = (uint8_t)ECS_INDEX(q.entity[i]);
+        c->count += n;
     }
+    if (!c->count) return;
+    crowd_schedule(c, target, dt);
 
-    for (int i = 0; i < ENEMY_POOL; ++i) {
-        Enemy *e = &em->e[i];
-        if (!e->active) continue;
-        attack(em,i,p);
-        enemy_update(e, p, dt);
+    // off ticks are plain seek: no neighbours, no queueing, no relaxation
+    bool separate = crowd_separation_due(c);
+    if (separate) {
+        crowd_build_grid(c);
+        crowd_gather_neighbours(c);
+    } else {
+        for (int a = 0; a < c->active; ++a) c->nbr_count[c->act[a]] = 0;
+    }
 
-        // bullet collision
-        for (int b = 0; b < BULLET_POOL; ++b) {
-            Bullet *bul = &p->gun.bullets[b];
-            if (bul->active &&
-                CheckCollisionCircleRec(bul->pos, BULLET_RADIUS, e->collider)) {
-                e->health -= p->gun.damage;
-                PlaySound(hit_sound);
-                bul->active = false;
-            }
+    // seek (+ alignment with last frame's neighbour headings)
+    for (int a = 0; a < c->active; ++a) {
+        int i = (int)c->act[a];
+        Vector2 seek = Vector2Normalize(Vector2Subtract(target, c->p[i]));
+        float speed = c->speed[i];
+        // queue behind a touching neighbour that is already ahead of us
+        for (int k = 0; k < c->nbr_count[i]; ++k) {
+            Vector2 d = Vector2Subtract(c->p[c->nbr[i][k]], c->p[i]);
+            if (Vector2DotProduct(d, seek) > 0 &&
+                Vector2LengthSqr(d) < CROWD_SPACING * CROWD_SPACING) { speed = 0; break; }
         }
-
-        if (e->health <= 0) {
-            e->active = false;
-            em->alive--;
+        if (c->alignment > 0 && c->nbr_count[i]) {
+            Vector2 avg = { 0 };
+            for (int k = 0; k < c->nbr_count[i]; ++k)
+                avg = Vector2Add(avg, c->dir[c->nbr[i][k]]);
+            seek = Vector2Normalize(v2_scale_add(seek, c->alignment / c->nbr_count[i], avg));
         }
+        c->corr[i] = seek;
+        c->p[i] = v2_scale_add(c->p[i], speed * c->step[a], seek);
+    }
+    for (int a = 0; a < c->active; ++a) c->dir[c->act[a]] = c->corr[c->act[a]];
+
+    if (separate)
+        for (int it = 0; it < CROWD_ITERATIONS; ++it) crowd_relax(c);
+
+    int k = 0;
+    for (EcsQuery q = ecs_query(ecs, ENEMY_SIG); ecs_next(&q) && k < c->count;) {
+        int n = q.count < c->count - k ? q.count : c->count - k;
+        memcpy(ECS_COL(&q, COMP_POS, Vector2), &c->p[k],   n * sizeof(Vector2));
+        memcpy(ECS_COL(&q, COMP_DIR, Vector2), &c->dir[k], n * sizeof(Vector2));
+        k += n;
     }
 }
+//--------------------------- compact enemies ----------------
+// Kernels over ENEMY_Q_SIG rows. Seek and hit tests stay in fixed point;
+// only separation goes through the crowd's float arrays.
 
-static void enemy_draw(const EnemyManager *em) {
-    for (int i = 0; i < ENEMY_POOL; ++i)
-        if (em->e[i].active)
-            DrawRectangleRec(em->e[i].collider, GREEN);
+// 8-bit heading of (dx, dy): a polynomial atan over the first octant, then
+// integer folding. Headings toward the player are effectively random, so
+// the folds are selects rather than branches the predictor would miss.
+static inline uint8_t qangle(int32_t dx, int32_t dy) {
+    int32_t ax = dx < 0 ? -dx : dx, ay = dy < 0 ? -dy : dy;
+    int32_t swap = ay > ax;
+    float lo = (float)(swap ? ax : ay), hi = (float)(swap ? ay : ax) + 1e-20f;
+    float a = lo / hi, s = a * a;
+    float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+    int32_t t = (int32_t)(r * (128.0f / PI) + 0.5f);      // 0..32
+    t = swap   ? 64 - t  : t;
+    t = dx < 0 ? 128 - t : t;
+    t = dy < 0 ? -t      : t;
+    return (uint8_t)t;
 }
-static void draw_enemy_health(const EnemyManager *em,int index){
-    Vector2 fsize=MeasureTextEx(GetFontDefault(), TextFormat("%d", (int)em->e[index].health), 5, 0);
-    DrawText(TextFormat("%d", (int)em->e[index].health), em->e[index].pos.x-fsize.x*0.5f, em->e[index].pos.y-fsize.y-10, 5, BLACK);
+
+static void enemy_q_seek(EnemyManager *em, Vector2 target, float dt) {
+    const int32_t tx = (int32_t)(target.x * QPOS_ONE), ty = (int32_t)(target.y * QPOS_ONE);
+    const int32_t step = (int32_t)(em->max_speed * dt * QPOS_ONE * 16);     // Q4
+    for (EcsQuery q = ecs_query(em->ecs, ENEMY_Q_SIG); ecs_next(&q);) {
+        QPos    *pos = ECS_COL(&q, COMP_QPOS, QPos);
+        uint8_t *dir = ECS_COL(&q, COMP_QDIR, uint8_t);
+        for (int i = 0; i < q.count; ++i) {
+            int32_t dx = tx - pos[i].x, dy = ty - pos[i].y;
+            int32_t st = (dx | dy) ? step : 0;         // on target: stay put
+            uint8_t a = qangle(dx, dy);
+            int32_t x = pos[i].x + ((st * em->qcos[a]) >> 18);
+            int32_t y = pos[i].y + ((st * em->qsin[a]) >> 18);
+            dir[i] = a;
+            pos[i] = (QPos){ (uint16_t)CLAMP(x, 0, 0xFFFF), (uint16_t)CLAMP(y, 0, 0xFFFF) };
+        }
+    }
 }
-float start_timer=0;
-float start_time=3.0f;
-int start_pressed=0;
-int powerup_active=0;
 
-static void pickup_powerup(PowerUp* powerup, Player* player){
-    if(powerup->active){
-         if(CheckCollisionCircleRec(powerup->pos, powerup->size, player->collider)){
-            player->max_health*=(powerup->health_factor);
-            player->speed*=(powerup->speed_factor);
-            player->gun.fireRate*=(powerup->fireRate_factor);
-            player->gun.damage*=(powerup->damage_factor);
-            player->gun.reloadTime*=(powerup->reloadTime_factor);
-            player->health=player->max_health;
-            powerup->active=false;
-            PlaySound(powerup_sound);
-         }
+// Separation only: the compact path seeks on its own and does not queue.
+static void crowd_separate_q(Crowd *c, Ecs *ecs) {
+    c->count = 0;
+    if (!ecs_count(ecs, ENEMY_Q_SIG) || !crowd_separation_due(c)) return;
+    for (EcsQuery q = ecs_query(ecs, ENEMY_Q_SIG); ecs_next(&q);) {
+        const QPos *pos = ECS_COL(&q, COMP_QPOS, QPos);
+        for (int i = 0; i < q.count && c->count < ENEMY_POOL; ++i)
+            c->p[c->count++] = (Vector2){ pos[i].x * (1.0f / QPOS_ONE), pos[i].y * (1.0f / QPOS_ONE) };
+    }
+    crowd_activate_all(c);
+    crowd_build_grid(c);
+    crowd_gather_neighbours(c);
+    for (int it = 0; it < CROWD_ITERATIONS; ++it) crowd_relax(c);
+
+    int k = 0;
+    for (EcsQuery q = ecs_query(ecs, ENEMY_Q_SIG); ecs_next(&q) && k < c->count;) {
+        QPos *pos = ECS_COL(&q, COMP_QPOS, QPos);
+        for (int i = 0; i < q.count && k < c->count; ++i, ++k)
+            pos[i] = (QPos){ qpos_encode(c->p[k].x), qpos_encode(c->p[k].y) };
     }
 }
-void draw_powerup(const PowerUp* powerup){
-    char* type=" ";
-    char* rarity=" ";
-    Color color;
-    switch(powerup->type){
-        case HEAL:
-            type="HEAL";
-            break;
-        case FIRE_RATE:
+
+static bool attack(EnemyManager *e,Rectangle box,Player *p){
+    if(CheckCollisionRecs(p->collider,box)){
+        p->health-=e->damage;
+        e->alive--;
+        PlaySound(hit_sound);
+        return true;
+    }
+    return false;
+}
+
+
+// Live bullets binned by where an enemy's top-left corner would have to
+// be to touch them, so each enemy looks at one cell instead of every
+// bullet. A bullet covers at most 2x2 cells since BGRID_CELL exceeds
+// ENEMY_SIZE + 2 * BULLET_RADIUS.
+#define BGRID_CELL            32
+#define BGRID_W               (ARENA_W / BGRID_CELL + 1)
+#define BGRID_H               (ARENA_H / BGRID_CELL + 1)
+
+typedef struct {
+    int16_t head[BGRID_W * BGRID_H];
+    int16_t next[BULLET_POOL * 4];
+    uint8_t bullet[BULLET_POOL * 4];
+    int     used;
+} BulletGrid;
+
+// Truncation rounds negatives up, but those clamp to cell 0 either way.
+static inline int bgrid_cell(float x, float y) {
+    int cx = CLAMP((int)(x * (1.0f / BGRID_CELL)), 0, BGRID_W - 1);
+    int cy = CLAMP((int)(y * (1.0f / BGRID_CELL)), 0, BGRID_H - 1);
+    return cy * BGRID_W + cx;
+}
+
+static void bgrid_build(BulletGrid *g, Vector2 *const *bpos, int nb) {
+    memset(g->head, 0xFF, sizeof(g->head));
+    g->used = 0;
+    const float lo = ENEMY_SIZE + BULLET_RADIUS, hi = BULLET_RADIUS;
+    for (int b = 0; b < nb; ++b) {
+        Vector2 p = *bpos[b];
+        int c0 = bgrid_cell(p.x - lo, p.y - lo), c1 = bgrid_cell(p.x + hi, p.y + hi);
+        for (int cy = c0 / BGRID_W; cy <= c1 / BGRID_W; ++cy)
+            for (int cx = c0 % BGRID_W; cx <= c1 % BGRID_W; ++cx) {
+                int c = cy * BGRID_W + cx;
+                g->bullet[g->used] = (uint8_t)b;
+                g->next[g->used]   = g->head[c];
+                g->head[c]         = (int16_t)g->used++;
+            }
+    }
+}
+
+static void enemy_manager_update(EnemyManager *em, Crowd *crowd, Player *p, TimingWheel *tw, float dt) {
+    Ecs *ecs = em->ecs;
+    crowd_steer(crowd, ecs, p->pos, dt);
+    enemy_q_seek(em, p->pos, dt);
+    crowd_separate_q(crowd, ecs);
+
+    // columns stay put until the end-of-tick flush, so gather bullets once
+    int nb = 0;
+    Entity   bul[BULLET_POOL];
+    Vector2 *bpos[BULLET_POOL];
+    TimerId *bexp[BULLET_POOL];
+    for (EcsQuery q = ecs_query(ecs, BULLET_SIG); ecs_next(&q);) {
+        Vector2 *pos = ECS_COL(&q, COMP_POS, Vector2);
+        TimerId *exp = ECS_COL(&q, COMP_EXPIRY, TimerId);
+        for (int i = 0; i < q.count && nb < BULLET_POOL; ++i) {
+            if (!exp[i]) continue;
+            bul[nb] = q.entity[i]; bpos[nb] = &pos[i]; bexp[nb] = &exp[i]; nb++;
+        }
+    }
+    BulletGrid bg;
+    bgrid_build(&bg, bpos, nb);
+
+    for (EcsQuery q = ecs_query(ecs, ENEMY_SIG); ecs_next(&q);) {
+        Vector2 *pos    = ECS_COL(&q, COMP_POS, Vector2);
+        float   *health = ECS_COL(&q, COMP_HEALTH, float);
+        for (int i = 0; i < q.count; ++i) {
+            Rectangle box = { pos[i].x, pos[i].y, ENEMY_SIZE, ENEMY_SIZE };
+            if (attack(em, box, p)) { ecs_despawn(ecs, q.entity[i]); continue; }
+
+            // bullet collision
+            for (int k = bg.head[bgrid_cell(pos[i].x, pos[i].y)]; k >= 0; k = bg.next[k]) {
+                int b = bg.bullet[k];
+                if (*bexp[b] && CheckCollisionCircleRec(*bpos[b], BULLET_RADIUS, box)) {
+                    health[i] -= p->gun.damage;
+                    PlaySound(hit_sound);
+                    bullet_kill(ecs, tw, bul[b], bexp[b]);
+                }
+            }
+
+            if (health[i] <= 0) {
+                ecs_despawn(ecs, q.entity[i]);
+                em->alive--;
+            }
+        }
+    }
+
+    // same rules on the compact rows, in 1/64 px integers
+    const int32_t es = ENEMY_SIZE * QPOS_ONE, br = (int32_t)(BULLET_RADIUS * QPOS_ONE);
+    const int32_t px0 = (int32_t)(p->collider.x * QPOS_ONE), px1 = px0 + (int32_t)(p->collider.width * QPOS_ONE);
+    const int32_t py0 = (int32_t)(p->collider.y * QPOS_ONE), py1 = py0 + (int32_t)(p->collider.height * QPOS_ONE);
+    const int32_t dmg = (int32_t)ceilf(p->gun.damage / em->max_health * QHEALTH_MAX);
+    int32_t bx[BULLET_POOL], by[BULLET_POOL];
+    for (int b = 0; b < nb; ++b) {
+        bx[b] = (int32_t)(bpos[b]->x * QPOS_ONE);
+        by[b] = (int32_t)(bpos[b]->y * QPOS_ONE);
+    }
+    for (EcsQuery q = ecs_query(ecs, ENEMY_Q_SIG); ecs_next(&q);) {
+        const QPos *pos    = ECS_COL(&q, COMP_QPOS, QPos);
+        uint16_t   *health = ECS_COL(&q, COMP_QHEALTH, uint16_t);
+        for (int i = 0; i < q.count; ++i) {
+            int32_t x0 = pos[i].x, y0 = pos[i].y, x1 = x0 + es, y1 = y0 + es;
+            if (px0 < x1 && px1 > x0 && py0 < y1 && py1 > y0) {
+                p->health -= em->damage;
+                em->alive--;
+                PlaySound(hit_sound);
+                ecs_despawn(ecs, q.entity[i]);
+                continue;
+            }
+
+            int32_t h = health[i];
+            int cell = bgrid_cell((float)(x0 >> QPOS_SHIFT), (float)(y0 >> QPOS_SHIFT));
+            for (int k = bg.head[cell]; k >= 0; k = bg.next[k]) {
+                int b = bg.bullet[k];
+                if (!*bexp[b]) continue;
+                int32_t dx = bx[b] - CLAMP(bx[b], x0, x1), dy = by[b] - CLAMP(by[b], y0, y1);
+                if (dx < -br || dx > br || dy < -br || dy > br || dx*dx + dy*dy > br*br) continue;
+                h -= dmg;
+                PlaySound(hit_sound);
+                bullet_kill(ecs, tw, bul[b], bexp[b]);
+            }
+            if (h <= 0) {
+                ecs_despawn(ecs, q.entity[i]);
+                em->alive--;
+            }
+            health[i] = (uint16_t)CLAMP(h, 0, QHEALTH_MAX);
+        }
+    }
+}
+
+static void pickup_powerup(Ecs* ecs, Player* player){
+    for (EcsQuery q = ecs_query(ecs, POWERUP_SIG); ecs_next(&q);) {
+      for (int i = 0; i < q.count; ++i) {
+         const PowerUp *powerup = &ECS_COL(&q, COMP_POWERUP, PowerUp)[i];
+         if(CheckCollisionCircleRec(ECS_COL(&q, COMP_POS, Vector2)[i], powerup->size, player->collider)){
+            player->max_health*=(powerup->health_factor);
+            player->speed*=(powerup->speed_factor);
+            player->gun.fireRate*=(powerup->fireRate_factor);
+            player->gun.damage*=(powerup->damage_factor);
+            player->gun.reloadTime*=(powerup->reloadTime_factor);
+            player->health=player->max_health;
+            ecs_despawn(ecs, q.entity[i]);
+            PlaySound(powerup_sound);
+            telemetry_emit(TELEM_SIM, TELEM_POWERUP, (uint16_t)powerup->type, 0, powerup->rarity);
+         }
+      }
+    }
+}
+int gameover=0;
+
+//--------------------------- hostile shots ------------------
+// Enemy fire lives outside the ECS: up to SHOT_POOL shots as parallel
+// float arrays. One branch-free pass moves every shot and flags it against
+// the arena (plus a margin) and against the 3x3 SHOT_CELL cells around the
+// player, which the compiler turns into SIMD. A second pass skips clear
+// flags eight at a time and only touches shots that left the arena or sit
+// in the player's cells; just those get the exact hit test. Volleys that
+// fall due in a tick are queued and emitted together, each one its
+// pattern's direction table turned by the volley's angle.
+#define SHOT_POOL             (1 << 17)
+#define SHOT_RADIUS           3.0f
+#define SHOT_SPEED            140.0f  // px/s
+#define SHOT_DAMAGE           4
+#define SHOT_MARGIN           8.0f    // past the arena edge before a shot is dropped
+#define SHOT_CELL             32      // > PLAYER_SIZE / 2 + SHOT_RADIUS
+#define SHOT_MAX_PER_VOLLEY   16
+#define SHOT_VOLLEYS_MAX      4096    // per tick; shooters over it fire next tick
+#define SHOT_SPIRAL_TURN      (2 * PI / 40)
+#define SHOT_AIMED_SPREAD     0.12f   // rad between neighbours in a burst
+#define SHOT_OUT              1
+#define SHOT_NEAR             2
+
+typedef struct {
+    int   shots;                      // per volley
+    float every;                      // seconds between volleys
+} ShotPattern;
+
+static const ShotPattern shot_patterns[WAVE_TYPES] = {
+    [WAVE_RING]   = { 16, 2.0f },
+    [WAVE_SPIRAL] = { 4,  0.2f },
+    [WAVE_AIMED]  = { 5,  1.5f },
+};
+
+typedef struct {
+    float   x, y, angle;
+    uint8_t pattern;
+} Volley;
+
+typedef struct {
+    int     count;
+    int     volley_count;
+    Volley  volley[SHOT_VOLLEYS_MAX];
+    float   dir_x[WAVE_TYPES][SHOT_MAX_PER_VOLLEY];   // unit headings at angle 0
+    float   dir_y[WAVE_TYPES][SHOT_MAX_PER_VOLLEY];
+    float   x[SHOT_POOL], y[SHOT_POOL];
+    float   vx[SHOT_POOL], vy[SHOT_POOL];
+    uint8_t flag[SHOT_POOL];
+} ShotStore;
+
+static void shots_init(ShotStore *s) {
+    s->count = s->volley_count = 0;
+    for (int t = WAVE_RING; t < WAVE_TYPES; ++t) {
+        int n = shot_patterns[t].shots;
+        for (int i = 0; i < n; ++i) {
+            float a = t == WAVE_AIMED ? (i - (n - 1) * 0.5f) * SHOT_AIMED_SPREAD : i * (2 * PI / n);
+            s->dir_x[t][i] = cosf(a);
+            s->dir_y[t][i] = sinf(a);
+        }
+    }
+}
+
+static bool shots_queue(ShotStore *s, Vector2 from, float angle, int pattern) {
+    if (s->volley_count == SHOT_VOLLEYS_MAX) return false;
+    s->volley[s->volley_count++] = (Volley){ from.x, from.y, angle, (uint8_t)pattern };
+    return true;
+}
+
+// Turns every queued volley into shots; they are dropped once the pool is full.
+static void shots_emit(ShotStore *s) {
+    for (int v = 0; v < s->volley_count; ++v) {
+        const Volley *vo = &s->volley[v];
+        int n = shot_patterns[vo->pattern].shots;
+        if (n > SHOT_POOL - s->count) n = SHOT_POOL - s->count;
+        const float c = cosf(vo->angle) * SHOT_SPEED, sn = sinf(vo->angle) * SHOT_SPEED;
+        const float *tx = s->dir_x[vo->pattern], *ty = s->dir_y[vo->pattern];
+        float *restrict x  = s->x + s->count,  *restrict y  = s->y + s->count;
+        float *restrict vx = s->vx + s->count, *restrict vy = s->vy + s->count;
+        for (int i = 0; i < n; ++i) {
+            x[i]  = vo->x;
+            y[i]  = vo->y;
+            vx[i] = c * tx[i] - sn * ty[i];
+            vy[i] = sn * tx[i] + c * ty[i];
+        }
+        s->count += n;
+    }
+    s->volley_count = 0;
+}
+
+// Queues a volley from every shooter that is due. New shooters are armed
+// at a random point of their first period so a wave that spawned together
+// does not fire in lockstep.
+static void shots_fire(ShotStore *s, Ecs *ecs, Vector2 target, uint64_t now) {
+    for (EcsQuery q = ecs_query(ecs, COMP(COMP_RANGED) | COMP(COMP_ENEMY)); ecs_next(&q);) {
+        Ranged *r = ECS_COL(&q, COMP_RANGED, Ranged);
+        bool compact = q.a->sig & COMP(COMP_QPOS);
+        const Vector2 *pos  = compact ? NULL : ECS_COL(&q, COMP_POS, Vector2);
+        const QPos    *qpos = compact ? ECS_COL(&q, COMP_QPOS, QPos) : NULL;
+        for (int i = 0; i < q.count; ++i) {
+            const ShotPattern *pt = &shot_patterns[r[i].pattern];
+            uint32_t every = (uint32_t)secs_to_ticks(pt->every);
+            if (!r[i].due) r[i].due = (uint32_t)now + 1 + rng_u32() % every;
+            if ((uint32_t)now < r[i].due) continue;
+            Vector2 o = compact ? (Vector2){ qpos[i].x * (1.0f / QPOS_ONE), qpos[i].y * (1.0f / QPOS_ONE) }
+                                : pos[i];
+            o.x += ENEMY_SIZE / 2.0f;
+            o.y += ENEMY_SIZE / 2.0f;
+            float angle = r[i].pattern == WAVE_SPIRAL ? r[i].volleys * SHOT_SPIRAL_TURN
+                        : r[i].pattern == WAVE_AIMED  ? atan2f(target.y - o.y, target.x - o.x)
+                        : randf(0, 2 * PI / pt->shots);
+            if (!shots_queue(s, o, angle, r[i].pattern)) break;
+            r[i].volleys++;
+            r[i].due += every;
+        }
+    }
+    shots_emit(s);
+}
+
+// Moves every shot, drops those that left the arena and lands those that
+// touch the player's square (the one that is drawn, centred on pos).
+static void shots_update(ShotStore *s, Player *p, float dt) {
+    const int n = s->count;
+    float *restrict x = s->x, *restrict y = s->y;
+    const float *restrict vx = s->vx, *restrict vy = s->vy;
+    uint8_t *restrict flag = s->flag;
+    const float ox0 = -SHOT_MARGIN, ox1 = ARENA_W + SHOT_MARGIN;
+    const float oy0 = -SHOT_MARGIN, oy1 = ARENA_H + SHOT_MARGIN;
+    const float nx0 = (floorf(p->pos.x / SHOT_CELL) - 1) * SHOT_CELL, nx1 = nx0 + 3 * SHOT_CELL;
+    const float ny0 = (floorf(p->pos.y / SHOT_CELL) - 1) * SHOT_CELL, ny1 = ny0 + 3 * SHOT_CELL;
+    for (int i = 0; i < n; ++i) {
+        float xi = x[i] + vx[i] * dt, yi = y[i] + vy[i] * dt;
+        x[i] = xi;
+        y[i] = yi;
+        int out  = (xi < ox0) | (xi > ox1) | (yi < oy0) | (yi > oy1);
+        int near = (xi >= nx0) & (xi < nx1) & (yi >= ny0) & (yi < ny1);
+        flag[i] = (uint8_t)(out | near << 1);
+    }
+
+    // walking down, a shot swapped into a hole has already been looked at
+    Rectangle box = { p->pos.x - PLAYER_SIZE/2, p->pos.y - PLAYER_SIZE/2, PLAYER_SIZE, PLAYER_SIZE };
+    int hits = 0;
+    for (int i = n - 1; i >= 0; --i) {
+        if (i >= 7) {
+            uint64_t word;
+            memcpy(&word, flag + i - 7, sizeof(word));
+            if (!word) { i -= 7; continue; }
+        }
+        if (!flag[i]) continue;
+        if (!(flag[i] & SHOT_OUT)) {
+            if (!CheckCollisionCircleRec((Vector2){ x[i], y[i] }, SHOT_RADIUS, box)) continue;
+            hits++;
+        }
+        int last = --s->count;
+        x[i] = x[last]; y[i] = y[last]; s->vx[i] = vx[last]; s->vy[i] = vy[last];
+    }
+    if (hits) {
+        p->health -= SHOT_DAMAGE * hits;
+        PlaySound(hit_sound);
+    }
+}
+
+//--------------------------- wave files ---------------------
+// Authored waves compiled by tools/wavec (see waves.h). The file is mapped
+// read-only and never parsed into memory: a script walks the event table
+// with a cursor, so only the pages around it need to be resident however
+// large the waves are. One mapping is shared by every world.
+typedef struct {
+    uint8_t           *base;
+    size_t             size;
+    const WavesHeader *h;
+    const WaveSpawner *spawners;
+    const WaveInfo    *waves;
+    const WaveEvent   *events;
+} WaveFile;
+
+#define WAVE_SPAWN_RESERVE    64      // queue slots a burst leaves for bullets and power-ups
+
+static WaveFile wave_file;       // --waves; base == NULL when not loaded
+
+static bool wave_table_ok(const WaveFile *f, uint64_t offset, uint64_t count, size_t size) {
+    return offset % 8 == 0 && offset <= f->size && count <= (f->size - offset) / size;
+}
+
+static bool wave_file_open(WaveFile *f, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) { TraceLog(LOG_WARNING, "WAVES: cannot open %s", path); return false; }
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(WavesHeader))
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                   // the mapping keeps the file alive
+    if (map == MAP_FAILED) { TraceLog(LOG_WARNING, "WAVES: cannot map %s", path); return false; }
+
+    *f = (WaveFile){ .base = map, .size = (size_t)st.st_size, .h = map };
+    const WavesHeader *h = f->h;
+    bool ok = memcmp(h->magic, WAVES_MAGIC, 4) == 0 && h->version == WAVES_VERSION &&
+              h->event_size == sizeof(WaveEvent) && h->wave_count > 0 &&
+              wave_table_ok(f, h->spawner_offset, h->spawner_count, sizeof(WaveSpawner)) &&
+              wave_table_ok(f, h->wave_offset, h->wave_count, sizeof(WaveInfo)) &&
+              wave_table_ok(f, h->event_offset, h->event_count, sizeof(WaveEvent));
+    if (ok) {
+        f->spawners = (const WaveSpawner *)(f->base + h->spawner_offset);
+        f->waves    = (const WaveInfo *)(f->base + h->wave_offset);
+        f->events   = (const WaveEvent *)(f->base + h->event_offset);
+        for (uint32_t i = 0; i < h->wave_count && ok; ++i)
+            ok = f->waves[i].first_event <= h->event_count &&
+                 f->waves[i].event_count <= h->event_count - f->waves[i].first_event &&
+                 f->waves[i].event_count <= WAVES_MAX_WAVE_EVENTS;   // the script's cursor is an int
+    }
+    if (!ok) {
+        TraceLog(LOG_WARNING, "WAVES: %s is not a v%d wave file", path, WAVES_VERSION);
+        munmap(f->base, f->size);
+        *f = (WaveFile){ 0 };
+        return false;
+    }
+    madvise(f->base + h->event_offset, h->event_count * sizeof(WaveEvent), MADV_SEQUENTIAL);
+    TraceLog(LOG_INFO, "WAVES: %s, %u wave(s), %llu event(s)", path, h->wave_count,
+             (unsigned long long)h->event_count);
+    return true;
+}
+
+static void wave_file_close(WaveFile *f) {
+    if (f->base) munmap(f->base, f->size);
+    *f = (WaveFile){ 0 };
+}
+
+static inline uint64_t wave_ms_to_ticks(uint32_t ms) {
+    return (uint64_t)ms * SIM_HZ / 1000;
+}
+
+static Vector2 wave_spawn_point(const WaveFile *f, const EnemyManager *em, uint16_t spawner) {
+    uint32_t n = f->h->spawner_count;
+    if (!n) {
+        uint32_t k = spawner == WAVES_RANDOM_SPAWNER ? rng_u32() : spawner;
+        return em->spawner[k % SPAWN_POINTS];
+    }
+    uint32_t k = spawner == WAVES_RANDOM_SPAWNER ? rng_u32() % n : spawner;
+    return k < n ? (Vector2){ f->spawners[k].x, f->spawners[k].y } : em->spawner[0];
+}
+
+// Wave parameters the rest of the game reads (HUD, compact health scale).
+static void wave_file_apply(EnemyManager *em, const WaveInfo *info) {
+    em->max_health   = info->max_hp > 0 ? info->max_hp : 1;
+    em->max_speed    = info->max_speed;
+    em->max_per_wave = (int)info->event_count;
+    em->waveDelay    = info->break_ms / 1000.0f;
+}
+
+//--------------------------- world --------------------------
+static const uint16_t comp_size[COMP_COUNT] = {
+    [COMP_POS]     = sizeof(Vector2),
+    [COMP_DIR]     = sizeof(Vector2),
+    [COMP_SPEED]   = sizeof(float),
+    [COMP_HEALTH]  = sizeof(float),
+    [COMP_EXPIRY]  = sizeof(TimerId),
+    [COMP_POWERUP] = sizeof(PowerUp),
+    [COMP_QPOS]    = sizeof(QPos),
+    [COMP_QDIR]    = sizeof(uint8_t),
+    [COMP_QHEALTH] = sizeof(uint16_t),
+    [COMP_RANGED]  = sizeof(Ranged),
+};
+
+typedef struct {
+    Ecs          ecs;
+    Player       player;
+    EnemyManager enemies;
+    Crowd        crowd;
+    ShotStore    shots;
+    TimingWheel  timers;
+    ScriptSched  scripts;
+    Entity       powerup;    // this break's power-up, 0 while a wave runs
+    InputLatch   latch;
+    bool         over;
+} World;
+
+// The default wave loop: trickle in max_per_wave enemies one spawnRate
+// apart, wait for the last one to die, then hold a break with a power-up
+// on the field before the next, harder wave.
+static bool wave_script(ScriptSched *sc, Script *s, void *ctx) {
+    World *w = ctx;
+    EnemyManager *em = &w->enemies;
+    SCRIPT_BEGIN(s);
+    for (;;) {
+        for (s->i = 0; s->i < em->max_per_wave; ++s->i) {
+            SCRIPT_SLEEP(sc, s, secs_to_ticks(em->spawnRate));
+            enemy_spawn(em);
+        }
+        SCRIPT_WAIT_UNTIL(sc, s, SCRIPT_EV_KILL, em->alive == 0);
+
+        em->wavePending = true;
+        em->waveDue     = sc->tw->now + secs_to_ticks(em->waveDelay);
+        w->powerup      = powerup_spawn(&w->ecs);
+        SCRIPT_SLEEP(sc, s, em->waveDue - sc->tw->now);
+        ecs_despawn(&w->ecs, w->powerup);           // no-op once picked up
+        w->powerup = 0;
+        enemy_wave_next(em);
+    }
+    SCRIPT_END(s);
+}
+
+// Plays the mapped wave file, starting over after its last wave. s->n is
+// the wave in the file, s->i the cursor into its events and s->at the
+// tick the wave started.
+static bool wave_file_script(ScriptSched *sc, Script *s, void *ctx) {
+    World *w = ctx;
+    EnemyManager *em = &w->enemies;
+    const WaveFile *f = &wave_file;
+    const WaveInfo *info = &f->waves[s->n];
+    SCRIPT_BEGIN(s);
+    wave_file_apply(em, info);
+    for (;;) {
+        s->at = sc->tw->now;
+        for (s->i = 0; s->i < (int)info->event_count;) {
+            uint64_t due = s->at + wave_ms_to_ticks(f->events[info->first_event + s->i].ms);
+            if (due > sc->tw->now) SCRIPT_SLEEP(sc, s, due - sc->tw->now);
+            // everything due by now, in file order, as far as the spawn queue
+            // and the pool allow; the cursor stays on the first event that
+            // did not fit and the rest follow next tick
+            for (; s->i < (int)info->event_count; ++s->i) {
+                const WaveEvent *e = &f->events[info->first_event + s->i];
+                if (s->at + wave_ms_to_ticks(e->ms) > sc->tw->now) break;
+                if (ecs_spawn_room(&w->ecs) <= WAVE_SPAWN_RESERVE || em->alive >= ENEMY_POOL) break;
+                if (!enemy_add_stats(em, wave_spawn_point(f, em, e->spawner), e->hp, e->speed, e->type)) break;
+            }
+            if (s->i < (int)info->event_count &&
+                s->at + wave_ms_to_ticks(f->events[info->first_event + s->i].ms) <= sc->tw->now)
+                SCRIPT_SLEEP(sc, s, 1);
+        }
+        SCRIPT_WAIT_UNTIL(sc, s, SCRIPT_EV_KILL, em->alive == 0);
+
+        em->wavePending = true;
+        em->waveDue     = sc->tw->now + secs_to_ticks(em->waveDelay);
+        w->powerup      = powerup_spawn(&w->ecs);
+        SCRIPT_SLEEP(sc, s, em->waveDue - sc->tw->now);
+        ecs_despawn(&w->ecs, w->powerup);
+        w->powerup = 0;
+
+        uint32_t kills = (uint32_t)(em->total_enemies - em->alive);
+        s->n  = (s->n + 1) % (int)f->h->wave_count;
+        info  = &f->waves[s->n];
+        em->wave++;
+        wave_file_apply(em, info);
+        enemy_wave_begin(em, kills);
+    }
+    SCRIPT_END(s);
+}
+
+static void world_init(World *w) {
+    ecs_init(&w->ecs, comp_size);
+    tw_init(&w->timers);
+    script_init(&w->scripts, &w->timers, w);
+    player_init(&w->player);
+    enemy_manager_init(&w->enemies, &w->ecs);
+    shots_init(&w->shots);
+    w->crowd.alignment = CROWD_ALIGNMENT;
+    w->crowd.lod       = true;
+    w->crowd.separate_every = 1;
+    w->powerup         = 0;
+    w->latch           = (InputLatch){ 0 };
+    w->over            = false;
+    script_start(&w->scripts, wave_file.base ? wave_file_script : wave_script, 0);
+}
+
+static void world_step(World *w, const InputFrame *in, float dt) {
+    tw_advance(&w->timers);
+    pickup_powerup(&w->ecs, &w->player);
+    player_update(&w->player, &w->ecs, in, &w->latch, &w->timers, dt);
+    bullet_update(&w->ecs, dt);
+    int alive = w->enemies.alive;
+    enemy_manager_update(&w->enemies, &w->crowd, &w->player, &w->timers, dt);
+    if (w->enemies.alive < alive) script_raise(&w->scripts, SCRIPT_EV_KILL);
+    shots_update(&w->shots, &w->player, dt);
+    shots_fire(&w->shots, &w->ecs, w->player.pos, w->timers.now);
+    script_dispatch(&w->scripts);
+    player_limit_movement(&w->player);
+    if (w->player.health <= 0 || in->quit) w->over = true;
+    ecs_flush(&w->ecs);
+}
+
+//--------------------------- render snapshots ---------------
+// Immutable copy of everything the renderer needs for one tick. The sim
+// thread fills one, the main thread draws another.
+typedef struct {
+    uint64_t tick;
+    double   input_stamp;            // sampling time of the newest input applied
+    float    sim_ms;                 // cost of the tick that produced this
+    bool     over;
+    Vector2  player_pos;
+    bool     powerup_active;
+    Vector2  powerup_pos;
+    PowerUp  powerup;
+    // HUD
+    int      wave, alive, max_per_wave, kills;
+    float    spawn_rate;
+    bool     wave_pending;
+    float    wave_countdown;
+    float    damage, fire_rate, reload_time, speed;
+    int      health, ammo, max_rounds;
+    bool     reloading;
+    // per-entity arrays last: everything above is SNAPSHOT_HEAD
+    int      bullet_count;
+    int      enemy_count;
+    int      shot_count;
+    Vector2  bullets[BULLET_POOL];
+    Vector2  enemy_pos[ENEMY_POOL];
+    float    enemy_health[ENEMY_POOL];
+    uint8_t  enemy_kind[ENEMY_POOL];     // WAVE_*
+    float    shot_x[SHOT_POOL], shot_y[SHOT_POOL];
+} RenderSnapshot;
+
+#define SNAPSHOT_HEAD         offsetof(RenderSnapshot, bullets)
+
+// Kinds of the first n rows of q's chunk, stored from s->enemy_count on.
+static void snapshot_kinds(RenderSnapshot *s, const EcsQuery *q, int n) {
+    uint8_t *kind = &s->enemy_kind[s->enemy_count];
+    if (!(q->a->sig & COMP(COMP_RANGED))) { memset(kind, WAVE_CHASER, n); return; }
+    const Ranged *r = ECS_COL(q, COMP_RANGED, Ranged);
+    for (int i = 0; i < n; ++i) kind[i] = r[i].pattern;
+}
+
+static void snapshot_capture(RenderSnapshot *s, const World *w, uint64_t tick) {
+    const Player       *p  = &w->player;
+    const EnemyManager *em = &w->enemies;
+    s->tick       = tick;
+    s->input_stamp = 0;
+    s->sim_ms      = 0;
+    s->over       = w->over;
+    s->player_pos = p->pos;
+
+    s->bullet_count = 0;
+    for (EcsQuery q = ecs_query(&w->ecs, BULLET_SIG); ecs_next(&q);) {
+        int n = q.count < BULLET_POOL - s->bullet_count ? q.count : BULLET_POOL - s->bullet_count;
+        memcpy(&s->bullets[s->bullet_count], ECS_COL(&q, COMP_POS, Vector2), n * sizeof(Vector2));
+        s->bullet_count += n;
+    }
+
+    s->enemy_count = 0;
+    for (EcsQuery q = ecs_query(&w->ecs, ENEMY_SIG); ecs_next(&q);) {
+        int n = q.count < ENEMY_POOL - s->enemy_count ? q.count : ENEMY_POOL - s->enemy_count;
+        memcpy(&s->enemy_pos[s->enemy_count],    ECS_COL(&q, COMP_POS, Vector2), n * sizeof(Vector2));
+        memcpy(&s->enemy_health[s->enemy_count], ECS_COL(&q, COMP_HEALTH, float), n * sizeof(float));
+        snapshot_kinds(s, &q, n);
+        s->enemy_count += n;
+    }
+    const float hscale = em->max_health / QHEALTH_MAX;
+    for (EcsQuery q = ecs_query(&w->ecs, ENEMY_Q_SIG); ecs_next(&q);) {
+        const QPos     *pos    = ECS_COL(&q, COMP_QPOS, QPos);
+        const uint16_t *health = ECS_COL(&q, COMP_QHEALTH, uint16_t);
+        int n = q.count < ENEMY_POOL - s->enemy_count ? q.count : ENEMY_POOL - s->enemy_count;
+        snapshot_kinds(s, &q, n);
+        for (int i = 0; i < n; ++i, ++s->enemy_count) {
+            s->enemy_pos[s->enemy_count]    = (Vector2){ pos[i].x * (1.0f / QPOS_ONE), pos[i].y * (1.0f / QPOS_ONE) };
+            s->enemy_health[s->enemy_count] = health[i] * hscale;
+        }
+    }
+    s->shot_count = w->shots.count;
+    memcpy(s->shot_x, w->shots.x, s->shot_count * sizeof(float));
+    memcpy(s->shot_y, w->shots.y, s->shot_count * sizeof(float));
+    s->powerup_active = ecs_alive(&w->ecs, w->powerup);
+    if (s->powerup_active) {
+        s->powerup_pos = *ECS_GET(&w->ecs, w->powerup, COMP_POS, Vector2);
+        s->powerup     = *ECS_GET(&w->ecs, w->powerup, COMP_POWERUP, PowerUp);
+    }
+
+    s->wave           = em->wave;
+    s->alive          = em->alive;
+    s->max_per_wave   = em->max_per_wave;
+    s->kills          = (int)em->total_enemies - em->alive;
+    s->spawn_rate     = em->spawnRate;
+    s->wave_pending   = em->wavePending;
+    s->wave_countdown = em->wavePending ? (float)(em->waveDue - w->timers.now) / SIM_HZ : 0;
+    s->damage         = p->gun.damage;
+    s->fire_rate      = p->gun.fireRate;
+    s->reload_time    = p->gun.reloadTime;
+    s->speed          = p->speed;
+    s->health         = p->health;
+    s->ammo           = p->gun.ammo;
+    s->max_rounds     = p->gun.max_rounds;
+    s->reloading      = p->gun.reloading;
+}
+
+//--------------------------- triple buffer ------------------
+// Lock-free single-writer/single-reader handoff. The writer always has a
+// private back slot, the reader a private front slot; `middle` holds the
+// most recent published slot and is swapped atomically by either side.
+#define TB_FRESH 4
+
+typedef struct {
+    RenderSnapshot slot[3];
+    _Atomic int    middle;       // slot index, | TB_FRESH until the reader takes it
+    int            back;         // writer only
+    int            front;        // reader only
+} TripleBuffer;
+
+static void tb_init(TripleBuffer *tb) {
+    tb->back  = 0;
+    tb->front = 2;
+    atomic_store(&tb->middle, 1);
+}
+
+static RenderSnapshot *tb_back(TripleBuffer *tb) {
+    return &tb->slot[tb->back];
+}
+
+static void tb_publish(TripleBuffer *tb) {
+    int prev = atomic_exchange_explicit(&tb->middle, tb->back | TB_FRESH, memory_order_acq_rel);
+    tb->back = prev & 3;
+}
+
+static const RenderSnapshot *tb_latest(TripleBuffer *tb) {
+    if (atomic_load_explicit(&tb->middle, memory_order_relaxed) & TB_FRESH) {
+        int prev = atomic_exchange_explicit(&tb->middle, tb->front, memory_order_acq_rel);
+        tb->front = prev & 3;
+    }
+    return &tb->slot[tb->front];
+}
+
+//--------------------------- replay -------------------------
+// The last few seconds of snapshots, for the kill-cam and scrubbing on the
+// END screen. Frames go into a fixed byte ring: every REPLAY_KEY_EVERY
+// ticks a keyframe with absolute positions, in between only per-enemy
+// position deltas (2 bytes while they fit in 8 bits) and the healths and
+// kinds that changed. Enemies are matched by snapshot order, so a
+// swap-removed row just costs one escape. Of the hostile shots only those
+// within REPLAY_SHOT_RANGE of the player are kept, enough to see what hit
+// them. Seeking decodes forward from the nearest keyframe, or from the
+// last decoded frame when scrubbing forwards.
+#define REPLAY_SECONDS        10
+#define REPLAY_FRAMES         (REPLAY_SECONDS * SIM_HZ)
+#define REPLAY_KEY_EVERY      30
+#define REPLAY_BYTES          (24 << 20)
+#define REPLAY_Q              8           // steps per pixel
+#define REPLAY_ORIGIN         (-3072.0f)  // 8192 px of range around the arena
+#define REPLAY_ESCAPE         (-128)
+#define REPLAY_SHOT_RANGE     240.0f
+#define REPLAY_SHOTS_MAX      1024
+// worst case for one frame: head, the bullet, enemy, shot and changed
+// counts, bullets, shots, then escape + position + health + kind per enemy
+#define REPLAY_FRAME_MAX(n)   (SNAPSHOT_HEAD + 4 * sizeof(int) + (BULLET_POOL + REPLAY_SHOTS_MAX) * 4 \
+                               + (size_t)(n) * 15)
+
+typedef struct {
+    uint64_t tick;
+    uint32_t offset, size;
+    bool     key;
+} ReplayFrame;
+
+typedef struct {
+    int      count;
+    uint16_t x[ENEMY_POOL], y[ENEMY_POOL];
+    float    health[ENEMY_POOL];
+    uint8_t  kind[ENEMY_POOL];
+} ReplayState;
+
+typedef struct {
+    uint64_t    first, next;              // frame sequence numbers held: [first, next)
+    ReplayFrame frame[REPLAY_FRAMES];
+    uint32_t    write;                    // byte offset of the next frame
+    ReplayState enc;                      // last frame recorded
+    ReplayState dec;                      // last frame decoded
+    uint64_t    dec_seq;                  // UINT64_MAX = none
+    uint8_t     bytes[REPLAY_BYTES];
+} Replay;
+
+// Written by the sim thread while a run is going, read by the main thread
+// once it has stopped. Allocated only by the modes that record: --bench and
+// the windowed game.
+static Replay *replay;
+
+static void replay_reset(Replay *r) {
+    r->first = r->next = 0;
+    r->write = 0;
+    r->enc.count = 0;
+    r->dec_seq = UINT64_MAX;
+}
+
+static inline uint16_t replay_q(float v) {
+    return (uint16_t)CLAMP((int)((v - REPLAY_ORIGIN) * REPLAY_Q + 0.5f), 0, 0xFFFF);
+}
+
+static inline float replay_dq(uint16_t v) {
+    return v * (1.0f / REPLAY_Q) + REPLAY_ORIGIN;
+}
+
+static inline uint8_t *replay_put(uint8_t *p, const void *v, size_t n) {
+    memcpy(p, v, n);
+    return p + n;
+}
+
+static inline const uint8_t *replay_get(const uint8_t *p, void *v, size_t n) {
+    memcpy(v, p, n);
+    return p + n;
+}
+
+// Drops frames from the front until `need` bytes at r->write are free, then
+// any deltas that lost their keyframe.
+static void replay_evict(Replay *r, uint32_t need) {
+    uint32_t lo = r->write, hi = r->write + need;
+    while (r->first < r->next) {
+        const ReplayFrame *f = &r->frame[r->first % REPLAY_FRAMES];
+        bool overlaps = f->offset < hi && f->offset + f->size > lo;
+        if (!overlaps && r->next - r->first < REPLAY_FRAMES) break;
+        r->first++;
+    }
+    while (r->first < r->next && !r->frame[r->first % REPLAY_FRAMES].key) r->first++;
+}
+
+static void replay_record(Replay *r, const RenderSnapshot *s) {
+    size_t need = REPLAY_FRAME_MAX(s->enemy_count);
+    if (need > REPLAY_BYTES / 2) return;          // cannot keep even two frames
+    if (r->write + need > REPLAY_BYTES) {
+        // what lies past the wrap point is the oldest lap's tail
+        while (r->first < r->next && r->frame[r->first % REPLAY_FRAMES].offset >= r->write) r->first++;
+        r->write = 0;
+    }
+    replay_evict(r, (uint32_t)need);
+
+    ReplayState *e = &r->enc;
+    bool key = r->next % REPLAY_KEY_EVERY == 0 || r->first == r->next;
+    uint8_t *p = r->bytes + r->write, *start = p;
+    p = replay_put(p, s, SNAPSHOT_HEAD);
+    p = replay_put(p, &s->bullet_count, sizeof(int));
+    p = replay_put(p, &s->enemy_count, sizeof(int));
+    for (int i = 0; i < s->bullet_count; ++i) {
+        uint16_t b[2] = { replay_q(s->bullets[i].x), replay_q(s->bullets[i].y) };
+        p = replay_put(p, b, sizeof(b));
+    }
+    uint8_t *shots_at = p;
+    int shots = 0;
+    p += sizeof(shots);
+    const float r2 = REPLAY_SHOT_RANGE * REPLAY_SHOT_RANGE;
+    for (int i = 0; i < s->shot_count && shots < REPLAY_SHOTS_MAX; ++i) {
+        float dx = s->shot_x[i] - s->player_pos.x, dy = s->shot_y[i] - s->player_pos.y;
+        if (dx * dx + dy * dy > r2) continue;
+        uint16_t xy[2] = { replay_q(s->shot_x[i]), replay_q(s->shot_y[i]) };
+        p = replay_put(p, xy, sizeof(xy));
+        shots++;
+    }
+    memcpy(shots_at, &shots, sizeof(shots));
+
+    int n = s->enemy_count, same = key ? 0 : (e->count < n ? e->count : n);
+    for (int i = 0; i < n; ++i) {
+        uint16_t x = replay_q(s->enemy_pos[i].x), y = replay_q(s->enemy_pos[i].y);
+        int dx = x - e->x[i], dy = y - e->y[i];
+        if (i < same && dx > REPLAY_ESCAPE && dx <= 127 && dy > REPLAY_ESCAPE && dy <= 127) {
+            *p++ = (uint8_t)(int8_t)dx;
+            *p++ = (uint8_t)(int8_t)dy;
+        } else {
+            if (i < same) { *p++ = (uint8_t)(int8_t)REPLAY_ESCAPE; *p++ = 0; }
+            uint16_t xy[2] = { x, y };
+            p = replay_put(p, xy, sizeof(xy));
+        }
+        e->x[i] = x;
+        e->y[i] = y;
+    }
+    // healths and kinds: all of them in a keyframe, otherwise (index, health, kind)
+    if (key) {
+        p = replay_put(p, s->enemy_health, n * sizeof(float));
+        p = replay_put(p, s->enemy_kind, n);
+        memcpy(e->health, s->enemy_health, n * sizeof(float));
+        memcpy(e->kind, s->enemy_kind, n);
+    } else {
+        uint8_t *count_at = p;
+        uint32_t changed = 0;
+        p += sizeof(changed);
+        for (int i = 0; i < n; ++i) {
+            if (i < same && e->health[i] == s->enemy_health[i] && e->kind[i] == s->enemy_kind[i]) continue;
+            uint32_t idx = (uint32_t)i;
+            p = replay_put(p, &idx, sizeof(idx));
+            p = replay_put(p, &s->enemy_health[i], sizeof(float));
+            *p++ = s->enemy_kind[i];
+            e->health[i] = s->enemy_health[i];
+            e->kind[i]   = s->enemy_kind[i];
+            changed++;
+        }
+        memcpy(count_at, &changed, sizeof(changed));
+    }
+    e->count = n;
+
+    r->frame[r->next % REPLAY_FRAMES] = (ReplayFrame){
+        .tick = s->tick, .offset = r->write, .size = (uint32_t)(p - start), .key = key };
+    r->next++;
+    r->write += (uint32_t)(p - start);
+}
+
+static size_t replay_bytes_held(const Replay *r) {
+    size_t n = 0;
+    for (uint64_t k = r->first; k < r->next; ++k) n += r->frame[k % REPLAY_FRAMES].size;
+    return n;
+}
+
+// Applies frame `seq` on top of r->dec (which must hold seq - 1 unless it is
+// a keyframe) and fills in `out` when given.
+static void replay_decode(Replay *r, uint64_t seq, RenderSnapshot *out) {
+    const ReplayFrame *f = &r->frame[seq % REPLAY_FRAMES];
+    const uint8_t *p = r->bytes + f->offset;
+    ReplayState *d = &r->dec;
+    RenderSnapshot head;
+    int bullets, n;
+    p = replay_get(p, &head, SNAPSHOT_HEAD);
+    p = replay_get(p, &bullets, sizeof(int));
+    p = replay_get(p, &n, sizeof(int));
+    if (out) {
+        memcpy(out, &head, SNAPSHOT_HEAD);
+        out->bullet_count = bullets;
+        out->enemy_count  = n;
+    }
+    for (int i = 0; i < bullets; ++i) {
+        uint16_t b[2];
+        p = replay_get(p, b, sizeof(b));
+        if (out) out->bullets[i] = (Vector2){ replay_dq(b[0]), replay_dq(b[1]) };
+    }
+    int shots;
+    p = replay_get(p, &shots, sizeof(shots));
+    if (out) out->shot_count = shots;
+    for (int i = 0; i < shots; ++i) {
+        uint16_t xy[2];
+        p = replay_get(p, xy, sizeof(xy));
+        if (!out) continue;
+        out->shot_x[i] = replay_dq(xy[0]);
+        out->shot_y[i] = replay_dq(xy[1]);
+    }
+
+    int same = f->key ? 0 : (d->count < n ? d->count : n);
+    for (int i = 0; i < n; ++i) {
+        if (i < same) {
+            int8_t dx = (int8_t)*p++, dy = (int8_t)*p++;
+            if (dx != REPLAY_ESCAPE) {
+                d->x[i] = (uint16_t)(d->x[i] + dx);
+                d->y[i] = (uint16_t)(d->y[i] + dy);
+                continue;
+            }
+        }
+        uint16_t xy[2];
+        p = replay_get(p, xy, sizeof(xy));
+        d->x[i] = xy[0];
+        d->y[i] = xy[1];
+    }
+    if (f->key) {
+        p = replay_get(p, d->health, n * sizeof(float));
+        p = replay_get(p, d->kind, n);
+    } else {
+        uint32_t changed;
+        p = replay_get(p, &changed, sizeof(changed));
+        for (uint32_t k = 0; k < changed; ++k) {
+            uint32_t idx;
+            p = replay_get(p, &idx, sizeof(idx));
+            p = replay_get(p, &d->health[idx], sizeof(float));
+            d->kind[idx] = *p++;
+        }
+    }
+    d->count = n;
+    r->dec_seq = seq;
+
+    if (!out) return;
+    for (int i = 0; i < n; ++i) out->enemy_pos[i] = (Vector2){ replay_dq(d->x[i]), replay_dq(d->y[i]) };
+    memcpy(out->enemy_health, d->health, n * sizeof(float));
+    memcpy(out->enemy_kind, d->kind, n);
+}
+
+// Rebuilds frame `seq` (clamped to what is held) into `out`; returns false
+// when the ring is empty.
+static bool replay_seek(Replay *r, uint64_t seq, RenderSnapshot *out) {
+    if (r->first == r->next) return false;
+    seq = CLAMP(seq, r->first, r->next - 1);
+    uint64_t from = seq;
+    while (from > r->first && !r->frame[from % REPLAY_FRAMES].key) from--;
+    if (r->dec_seq != UINT64_MAX && r->dec_seq >= from && r->dec_seq < seq) from = r->dec_seq + 1;
+    for (uint64_t k = from; k < seq; ++k) replay_decode(r, k, NULL);
+    replay_decode(r, seq, out);
+    return true;
+}
+
+//--------------------------- governor -----------------------
+// Watches how much of its budget each frame and tick uses and sheds
+// optional work one stage at a time. A stage is dropped after
+// GOV_DEGRADE_FRAMES frames above GOV_HIGH and restored after
+// GOV_RESTORE_FRAMES frames below GOV_LOW, so it does not flap at the edge.
+#define GOV_FRAME_BUDGET_MS   (1000.0f / 60)
+#define GOV_HIGH              0.90f
+#define GOV_LOW               0.60f
+#define GOV_DEGRADE_FRAMES    30
+#define GOV_RESTORE_FRAMES    120
+#define GOV_SMOOTHING         0.1f
+#define GOV_LABEL_CAP         200
+
+typedef enum {
+    QUALITY_FULL,
+    QUALITY_FEW_LABELS,          // thin enemy health labels to GOV_LABEL_CAP
+    QUALITY_NO_LABELS,           // hide them
+    QUALITY_HALF_SEPARATION,     // crowd separation every other tick
+    QUALITY_HALF_RES,            // scene target at half the chosen render scale
+    QUALITY_LEVELS
+} Quality;
+
+typedef struct {
+    _Atomic int level;           // also read by the sim thread
+    int         forced;          // fixed level, -1 = automatic
+    float       load;            // smoothed, 1 = exactly on budget
+    int         over, under;     // consecutive frames past each threshold
+} Governor;
+
+static Governor gov = { .forced = -1 };
+
+static int governor_level(void) {
+    return atomic_load_explicit(&gov.level, memory_order_relaxed);
+}
+
+// frame_ms is render work only (no frame-pacing wait); sim_ms one tick.
+static void governor_update(Governor *g, float frame_ms, float sim_ms) {
+    float load = fmaxf(frame_ms / GOV_FRAME_BUDGET_MS, sim_ms * SIM_HZ / 1000.0f);
+    g->load += (load - g->load) * GOV_SMOOTHING;
+    int level = atomic_load_explicit(&g->level, memory_order_relaxed), next = level;
+    if (g->forced >= 0) {
+        next = CLAMP(g->forced, 0, QUALITY_LEVELS - 1);
+    } else if (g->load > GOV_HIGH) {
+        g->under = 0;
+        if (++g->over >= GOV_DEGRADE_FRAMES && level < QUALITY_LEVELS - 1) { next++; g->over = 0; }
+    } else if (g->load < GOV_LOW) {
+        g->over = 0;
+        if (++g->under >= GOV_RESTORE_FRAMES && level > 0) { next--; g->under = 0; }
+    } else {
+        g->over = g->under = 0;
+    }
+    if (next == level) return;
+    atomic_store_explicit(&g->level, next, memory_order_relaxed);
+    telemetry_emit(TELEM_RENDER, TELEM_QUALITY, (uint16_t)next, g->load, (uint32_t)level);
+}
+
+// sim-side stages, applied before each tick
+static void quality_apply(World *w, int level) {
+    w->crowd.separate_every = level >= QUALITY_HALF_SEPARATION ? 2 : 1;
+}
+
+//--------------------------- simulation thread --------------
+typedef struct {
+    World          world;
+    TripleBuffer   snapshots;
+    SpscRing       input;
+    InputFrame     input_slots[INPUT_QUEUE];
+    InputFrame     latched;      // most recent input seen by the sim
+    uint64_t       tick;
+    uint64_t       seed;
+    pthread_t      thread;
+    _Atomic bool   running;
+    _Atomic bool   paused;       // thread parks on `wake` instead of ticking
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+} Sim;
+
+static Sim *sim;                 // the windowed game only
+
+static Sim *sim_create(void) {
+    Sim *s = calloc(1, sizeof(Sim));
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    return s;
+}
+
+static void sim_drain_input(Sim *s) {
+    InputFrame in;
+    bool quit = false;
+    while (spsc_pop(&s->input, &in)) {
+        quit |= in.quit;
+        s->latched = in;
+    }
+    s->latched.quit = quit;      // edges count once, held state persists
+}
+
+// Mid-tick top-up: picks up frames pushed since the tick started without
+// dropping an edge the tick has already seen.
+static const InputFrame *sim_relatch(void *ctx) {
+    Sim *s = ctx;
+    bool quit = s->latched.quit;
+    sim_drain_input(s);
+    s->latched.quit |= quit;
+    return &s->latched;
+}
+
+static void *sim_main(void *arg) {
+    Sim *s = arg;
+    const float dt = 1.0f / SIM_HZ;
+    rng_seed(s->seed);
+    double next = now_seconds();
+    while (atomic_load_explicit(&s->running, memory_order_acquire)) {
+        if (atomic_load_explicit(&s->paused, memory_order_acquire)) {
+            pthread_mutex_lock(&s->lock);
+            while (s->paused && s->running) pthread_cond_wait(&s->wake, &s->lock);
+            pthread_mutex_unlock(&s->lock);
+            next = now_seconds();        // the pause is not a backlog
+            continue;
+        }
+        double t0 = now_seconds();
+        telemetry_stamp(TELEM_SIM, (uint32_t)s->tick);
+        sim_drain_input(s);
+        quality_apply(&s->world, governor_level());
+        world_step(&s->world, &s->latched, dt);
+        s->tick++;
+        double t1 = now_seconds();
+        RenderSnapshot *snap = tb_back(&s->snapshots);
+        snapshot_capture(snap, &s->world, s->tick);
+        snap->input_stamp = s->latched.stamp;
+        snap->sim_ms      = (float)((t1 - t0) * 1e3);
+        replay_record(replay, snap);
+        tb_publish(&s->snapshots);
+        telemetry_emit(TELEM_SIM, TELEM_TICK, (uint16_t)CLAMP(snap->enemy_count, 0, 0xFFFF),
+                       (float)((now_seconds() - t0) * 1e3), (uint32_t)snap->bullet_count);
+        if (s->world.over) {
+            const EnemyManager *em = &s->world.enemies;
+            telemetry_emit(TELEM_SIM, TELEM_RUN_END, (uint16_t)em->wave, (float)s->tick / SIM_HZ,
+                           (uint32_t)(em->total_enemies - em->alive));
+            break;
+        }
+
+        next += dt;
+        double t = now_seconds();
+        if (t - next > 0.25) next = t;   // far behind: drop the backlog instead of spiralling
+        else sleep_until(next);
+    }
+    return NULL;
+}
+
+static void sim_start(Sim *s) {
+    world_init(&s->world);
+    s->world.latch = (InputLatch){ sim_relatch, s };
+    s->tick    = 0;
+    s->seed    = rng_u32();          // from the main thread's stream
+    s->latched = (InputFrame){ 0 };
+    spsc_init(&s->input, s->input_slots, INPUT_QUEUE, sizeof(InputFrame));
+    tb_init(&s->snapshots);
+    snapshot_capture(&s->snapshots.slot[s->snapshots.front], &s->world, 0);
+    replay_reset(replay);
+    telemetry_stamp(TELEM_SIM, 0);
+    telemetry_emit(TELEM_SIM, TELEM_RUN_START, 0, 0, 0);
+    atomic_store(&s->paused, false);
+    atomic_store(&s->running, true);
+    pthread_create(&s->thread, NULL, sim_main, s);
+}
+
+// Freezes the world between ticks; the thread sleeps until resumed, so a
+// paused game costs no CPU and its timers, replay and waves stand still.
+static void sim_pause(Sim *s, bool paused) {
+    pthread_mutex_lock(&s->lock);
+    atomic_store(&s->paused, paused);
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void sim_stop(Sim *s) {
+    pthread_mutex_lock(&s->lock);
+    bool was = atomic_exchange(&s->running, false);
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    if (was) pthread_join(s->thread, NULL);
+}
+
+//--------------------------- software rasterizer ------------
+// CPU backend for the handful of primitives the game draws. Commands are
+// recorded and binned into SR_TILE tiles; at flush, worker threads claim
+// whole tiles so no two threads ever write the same pixel. Every colour
+// the game uses is opaque, so spans are plain stores (SSE2 when available).
+#define SR_TILE               64
+#define SR_MAX_THREADS        16
+#define SR_GLYPH_W            5
+#define SR_GLYPH_H            7
+#define SR_GLYPH_ADVANCE      6
+#define SR_DOT_BIAS           4096    // > how far off screen a dot can start
+
+// Classic 5x7 ASCII font (0x20..0x7E), column-major, bit 0 = top row.
+static const uint8_t sr_font[95][SR_GLYPH_W] = {
+    {0x00,0x00,0x00,0x00,0x00},{0x00,0x00,0x5F,0x00,0x00},{0x00,0x07,0x00,0x07,0x00},{0x14,0x7F,0x14,0x7F,0x14},
+    {0x24,0x2A,0x7F,0x2A,0x12},{0x23,0x13,0x08,0x64,0x62},{0x36,0x49,0x55,0x22,0x50},{0x00,0x05,0x03,0x00,0x00},
+    {0x00,0x1C,0x22,0x41,0x00},{0x00,0x41,0x22,0x1C,0x00},{0x14,0x08,0x3E,0x08,0x14},{0x08,0x08,0x3E,0x08,0x08},
+    {0x00,0x50,0x30,0x00,0x00},{0x08,0x08,0x08,0x08,0x08},{0x00,0x60,0x60,0x00,0x00},{0x20,0x10,0x08,0x04,0x02},
+    {0x3E,0x51,0x49,0x45,0x3E},{0x00,0x42,0x7F,0x40,0x00},{0x42,0x61,0x51,0x49,0x46},{0x21,0x41,0x45,0x4B,0x31},
+    {0x18,0x14,0x12,0x7F,0x10},{0x27,0x45,0x45,0x45,0x39},{0x3C,0x4A,0x49,0x49,0x30},{0x01,0x71,0x09,0x05,0x03},
+    {0x36,0x49,0x49,0x49,0x36},{0x06,0x49,0x49,0x29,0x1E},{0x00,0x36,0x36,0x00,0x00},{0x00,0x56,0x36,0x00,0x00},
+    {0x08,0x14,0x22,0x41,0x00},{0x14,0x14,0x14,0x14,0x14},{0x00,0x41,0x22,0x14,0x08},{0x02,0x01,0x51,0x09,0x06},
+    {0x32,0x49,0x79,0x41,0x3E},{0x7E,0x11,0x11,0x11,0x7E},{0x7F,0x49,0x49,0x49,0x36},{0x3E,0x41,0x41,0x41,0x22},
+    {0x7F,0x41,0x41,0x22,0x1C},{0x7F,0x49,0x49,0x49,0x41},{0x7F,0x09,0x09,0x09,0x01},{0x3E,0x41,0x49,0x49,0x7A},
+    {0x7F,0x08,0x08,0x08,0x7F},{0x00,0x41,0x7F,0x41,0x00},{0x20,0x40,0x41,0x3F,0x01},{0x7F,0x08,0x14,0x22,0x41},
+    {0x7F,0x40,0x40,0x40,0x40},{0x7F,0x02,0x0C,0x02,0x7F},{0x7F,0x04,0x08,0x10,0x7F},{0x3E,0x41,0x41,0x41,0x3E},
+    {0x7F,0x09,0x09,0x09,0x06},{0x3E,0x41,0x51,0x21,0x5E},{0x7F,0x09,0x19,0x29,0x46},{0x46,0x49,0x49,0x49,0x31},
+    {0x01,0x01,0x7F,0x01,0x01},{0x3F,0x40,0x40,0x40,0x3F},{0x1F,0x20,0x40,0x20,0x1F},{0x3F,0x40,0x38,0x40,0x3F},
+    {0x63,0x14,0x08,0x14,0x63},{0x07,0x08,0x70,0x08,0x07},{0x61,0x51,0x49,0x45,0x43},{0x00,0x7F,0x41,0x41,0x00},
+    {0x02,0x04,0x08,0x10,0x20},{0x00,0x41,0x41,0x7F,0x00},{0x04,0x02,0x01,0x02,0x04},{0x40,0x40,0x40,0x40,0x40},
+    {0x00,0x01,0x02,0x04,0x00},{0x20,0x54,0x54,0x54,0x78},{0x7F,0x48,0x44,0x44,0x38},{0x38,0x44,0x44,0x44,0x20},
+    {0x38,0x44,0x44,0x48,0x7F},{0x38,0x54,0x54,0x54,0x18},{0x08,0x7E,0x09,0x01,0x02},{0x0C,0x52,0x52,0x52,0x3E},
+    {0x7F,0x08,0x04,0x04,0x78},{0x00,0x44,0x7D,0x40,0x00},{0x20,0x40,0x44,0x3D,0x00},{0x7F,0x10,0x28,0x44,0x00},
+    {0x00,0x41,0x7F,0x40,0x00},{0x7C,0x04,0x18,0x04,0x78},{0x7C,0x08,0x04,0x04,0x78},{0x38,0x44,0x44,0x44,0x38},
+    {0x7C,0x14,0x14,0x14,0x08},{0x08,0x14,0x14,0x18,0x7C},{0x7C,0x08,0x04,0x04,0x08},{0x48,0x54,0x54,0x54,0x20},
+    {0x04,0x3F,0x44,0x40,0x20},{0x3C,0x40,0x40,0x20,0x7C},{0x1C,0x20,0x40,0x20,0x1C},{0x3C,0x40,0x30,0x40,0x3C},
+    {0x44,0x28,0x10,0x28,0x44},{0x0C,0x50,0x50,0x50,0x3C},{0x44,0x64,0x54,0x4C,0x44},{0x00,0x08,0x36,0x41,0x00},
+    {0x00,0x00,0x7F,0x00,0x00},{0x00,0x41,0x36,0x08,0x00},{0x10,0x08,0x08,0x10,0x08},
+};
+
+typedef enum { SR_RECT, SR_CIRCLE, SR_TEXT, SR_DOTS } SrOp;
+
+typedef struct {
+    uint8_t  op, scale;          // SR_DOTS: side in pixels
+    uint32_t color;              // packed in framebuffer byte order (RGBA)
+    int      x0, y0, x1, y1;     // screen-clipped bounds, max exclusive
+    float    cx, cy, r;          // SR_CIRCLE
+    uint32_t text;               // SR_TEXT: offset into the text arena, SR_DOTS: into the dots
+    uint32_t count;              // SR_DOTS
+} SrCmd;
+
+typedef struct { int16_t x, y; } SrDot;    // top-left pixel
+
+typedef struct { uint32_t *items; int count, cap; } SrBin;
+
+typedef struct {
+    int              w, h, tiles_x, tiles_y;
+    uint32_t        *pixels;
+    SrCmd           *cmds;
+    int              cmd_count, cmd_cap;
+    char            *text;
+    int              text_len, text_cap;
+    SrDot           *dots;       // per-tile runs, one SR_DOTS command each
+    int              dot_len, dot_cap;
+    int             *dot_fill;   // per tile, scratch for sr_dots
+    SrDot           *corner;     // per dot, scratch for sr_dots
+    int              corner_cap;
+    SrBin           *bins;
+
+    int              threads;    // including the flushing thread
+    pthread_t        workers[SR_MAX_THREADS];
+    pthread_mutex_t  lock;
+    pthread_cond_t   wake, done;
+    uint64_t         generation;
+    int              busy;
+    bool             quit;
+    _Atomic int      next_tile;
+} SoftRaster;
+
+static inline uint32_t sr_pack(Color c) {
+    uint32_t v;
+    memcpy(&v, &c, sizeof(v));
+    return v;
+}
+
+static inline void sr_span(uint32_t *dst, int n, uint32_t c) {
+#if defined(__SSE2__)
+    __m128i v = _mm_set1_epi32((int)c);
+    for (; n >= 8; n -= 8, dst += 8) {
+        _mm_storeu_si128((__m128i *)dst, v);
+        _mm_storeu_si128((__m128i *)(dst + 4), v);
+    }
+#endif
+    while (n-- > 0) *dst++ = c;
+}
+
+static void sr_fill(SoftRaster *r, int x0, int y0, int x1, int y1, uint32_t c) {
+    for (int y = y0; y < y1; ++y) sr_span(r->pixels + (size_t)y * r->w + x0, x1 - x0, c);
+}
+
+static void sr_raster_cmd(SoftRaster *r, const SrCmd *c, int X0, int Y0, int X1, int Y1) {
+    int x0 = c->x0 > X0 ? c->x0 : X0, x1 = c->x1 < X1 ? c->x1 : X1;
+    int y0 = c->y0 > Y0 ? c->y0 : Y0, y1 = c->y1 < Y1 ? c->y1 : Y1;
+    if (x0 >= x1 || y0 >= y1) return;
+    switch (c->op) {
+    case SR_RECT:
+        sr_fill(r, x0, y0, x1, y1, c->color);
+        break;
+    case SR_CIRCLE:
+        for (int y = y0; y < y1; ++y) {
+            float dy = y + 0.5f - c->cy, h2 = c->r * c->r - dy * dy;
+            if (h2 < 0) continue;
+            float hw = sqrtf(h2);
+            int a = (int)ceilf(c->cx - hw - 0.5f), b = (int)floorf(c->cx + hw - 0.5f) + 1;
+            if (a < x0) a = x0;
+            if (b > x1) b = x1;
+            if (a < b) sr_span(r->pixels + (size_t)y * r->w + a, b - a, c->color);
+        }
+        break;
+    case SR_TEXT: {
+        const int s = c->scale;
+        int gx = (int)c->cx;                   // text origin lives in cx/cy
+        for (const char *t = r->text + c->text; *t; ++t, gx += SR_GLYPH_ADVANCE * s) {
+            if (gx >= x1 || gx + SR_GLYPH_W * s <= x0) continue;
+            unsigned ch = (unsigned char)*t;
+            if (ch < 0x20 || ch > 0x7E) ch = '?';
+            const uint8_t *g = sr_font[ch - 0x20];
+            for (int col = 0; col < SR_GLYPH_W; ++col)
+                for (int row = 0; row < SR_GLYPH_H; ++row) {
+                    if (!(g[col] >> row & 1)) continue;
+                    int px0 = gx + col * s, py0 = (int)c->cy + row * s;
+                    int px1 = px0 + s, py1 = py0 + s;
+                    if (px0 < x0) px0 = x0;
+                    if (py0 < y0) py0 = y0;
+                    if (px1 > x1) px1 = x1;
+                    if (py1 > y1) py1 = y1;
+                    if (px0 < px1 && py0 < py1) sr_fill(r, px0, py0, px1, py1, c->color);
+                }
+        }
+    } break;
+    case SR_DOTS: {
+        const int side = c->scale;
+        const SrDot *d = r->dots + c->text;
+        for (uint32_t k = 0; k < c->count; ++k) {
+            int px0 = d[k].x, py0 = d[k].y, px1 = px0 + side, py1 = py0 + side;
+            if (px0 >= x0 && py0 >= y0 && px1 <= x1 && py1 <= y1) {     // inside the tile
+                uint32_t *row = r->pixels + (size_t)py0 * r->w + px0;
+                for (int y = 0; y < side; ++y, row += r->w)
+                    for (int x = 0; x < side; ++x) row[x] = c->color;
+                continue;
+            }
+            px0 = px0 > x0 ? px0 : x0; px1 = px1 < x1 ? px1 : x1;
+            py0 = py0 > y0 ? py0 : y0; py1 = py1 < y1 ? py1 : y1;
+            if (px0 < px1 && py0 < py1) sr_fill(r, px0, py0, px1, py1, c->color);
+        }
+    } break;
+    }
+}
+
+static void sr_raster_tiles(SoftRaster *r) {
+    const int tiles = r->tiles_x * r->tiles_y;
+    for (;;) {
+        int t = atomic_fetch_add_explicit(&r->next_tile, 1, memory_order_relaxed);
+        if (t >= tiles) break;
+        int X0 = (t % r->tiles_x) * SR_TILE, Y0 = (t / r->tiles_x) * SR_TILE;
+        int X1 = X0 + SR_TILE < r->w ? X0 + SR_TILE : r->w;
+        int Y1 = Y0 + SR_TILE < r->h ? Y0 + SR_TILE : r->h;
+        const SrBin *b = &r->bins[t];
+        for (int k = 0; k < b->count; ++k) sr_raster_cmd(r, &r->cmds[b->items[k]], X0, Y0, X1, Y1);
+    }
+}
+
+static void *sr_worker(void *arg) {
+    SoftRaster *r = arg;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&r->lock);
+    for (;;) {
+        while (r->generation == seen && !r->quit) pthread_cond_wait(&r->wake, &r->lock);
+        if (r->quit) break;
+        seen = r->generation;
+        pthread_mutex_unlock(&r->lock);
+        sr_raster_tiles(r);
+        pthread_mutex_lock(&r->lock);
+        if (--r->busy == 0) pthread_cond_signal(&r->done);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+static void sr_init(SoftRaster *r, int w, int h, int threads) {
+    *r = (SoftRaster){ .w = w, .h = h };
+    r->tiles_x = (w + SR_TILE - 1) / SR_TILE;
+    r->tiles_y = (h + SR_TILE - 1) / SR_TILE;
+    r->pixels  = calloc((size_t)w * h, sizeof(uint32_t));
+    r->bins    = calloc((size_t)r->tiles_x * r->tiles_y, sizeof(SrBin));
+    r->dot_fill = calloc((size_t)r->tiles_x * r->tiles_y, sizeof(int));
+    r->threads = CLAMP(threads, 1, SR_MAX_THREADS);
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->wake, NULL);
+    pthread_cond_init(&r->done, NULL);
+    for (int i = 1; i < r->threads; ++i) pthread_create(&r->workers[i], NULL, sr_worker, r);
+}
+
+static void sr_shutdown(SoftRaster *r) {
+    pthread_mutex_lock(&r->lock);
+    r->quit = true;
+    pthread_cond_broadcast(&r->wake);
+    pthread_mutex_unlock(&r->lock);
+    for (int i = 1; i < r->threads; ++i) pthread_join(r->workers[i], NULL);
+    for (int t = 0; t < r->tiles_x * r->tiles_y; ++t) free(r->bins[t].items);
+    free(r->bins); free(r->pixels); free(r->cmds); free(r->text);
+    free(r->dots); free(r->dot_fill); free(r->corner);
+}
+
+static void sr_begin(SoftRaster *r) {
+    r->cmd_count = 0;
+    r->text_len  = 0;
+    r->dot_len   = 0;
+    for (int t = 0; t < r->tiles_x * r->tiles_y; ++t) r->bins[t].count = 0;
+}
+
+static void sr_push(SoftRaster *r, SrCmd c) {
+    if (c.x0 < 0) c.x0 = 0;
+    if (c.y0 < 0) c.y0 = 0;
+    if (c.x1 > r->w) c.x1 = r->w;
+    if (c.y1 > r->h) c.y1 = r->h;
+    if (c.x0 >= c.x1 || c.y0 >= c.y1) return;
+    if (r->cmd_count == r->cmd_cap) {
+        r->cmd_cap = r->cmd_cap ? r->cmd_cap * 2 : 4096;
+        r->cmds = realloc(r->cmds, r->cmd_cap * sizeof(SrCmd));
+    }
+    uint32_t idx = (uint32_t)r->cmd_count;
+    r->cmds[r->cmd_count++] = c;
+    for (int ty = c.y0 / SR_TILE; ty <= (c.y1 - 1) / SR_TILE; ++ty)
+        for (int tx = c.x0 / SR_TILE; tx <= (c.x1 - 1) / SR_TILE; ++tx) {
+            SrBin *b = &r->bins[ty * r->tiles_x + tx];
+            if (b->count == b->cap) {
+                b->cap = b->cap ? b->cap * 2 : 256;
+                b->items = realloc(b->items, b->cap * sizeof(uint32_t));
+            }
+            b->items[b->count++] = idx;
+        }
+}
+
+static void sr_clear(SoftRaster *r, Color c) {
+    sr_begin(r);                                   // everything before is overdrawn
+    sr_push(r, (SrCmd){ .op = SR_RECT, .color = sr_pack(c), .x0 = 0, .y0 = 0, .x1 = r->w, .y1 = r->h });
+}
+
+static void sr_rect(SoftRaster *r, Rectangle rc, Color c) {
+    sr_push(r, (SrCmd){ .op = SR_RECT, .color = sr_pack(c),
+                        .x0 = (int)floorf(rc.x + 0.5f), .y0 = (int)floorf(rc.y + 0.5f),
+                        .x1 = (int)floorf(rc.x + rc.width + 0.5f), .y1 = (int)floorf(rc.y + rc.height + 0.5f) });
+}
+
+static void sr_circle(SoftRaster *r, Vector2 p, float radius, Color c) {
+    sr_push(r, (SrCmd){ .op = SR_CIRCLE, .color = sr_pack(c), .cx = p.x, .cy = p.y, .r = radius,
+                        .x0 = (int)floorf(p.x - radius), .y0 = (int)floorf(p.y - radius),
+                        .x1 = (int)ceilf(p.x + radius) + 1, .y1 = (int)ceilf(p.y + radius) + 1 });
+}
+
+static int sr_text_scale(int size) {
+    return size >= 20 ? size / 10 : 1;             // raylib's default font is 10px high
+}
+
+static Vector2 sr_measure(const char *text, int size) {
+    int s = sr_text_scale(size), n = (int)strlen(text);
+    return (Vector2){ (float)(n ? n * SR_GLYPH_ADVANCE * s - s : 0), (float)(SR_GLYPH_H * s) };
+}
+
+static void sr_text(SoftRaster *r, const char *text, int x, int y, int size, Color c) {
+    int n = (int)strlen(text), s = sr_text_scale(size);
+    if (!n) return;
+    if (r->text_len + n + 1 > r->text_cap) {
+        r->text_cap = (r->text_len + n + 1) * 2;
+        r->text = realloc(r->text, r->text_cap);
+    }
+    memcpy(r->text + r->text_len, text, n + 1);
+    sr_push(r, (SrCmd){ .op = SR_TEXT, .scale = (uint8_t)s, .color = sr_pack(c),
+                        .cx = (float)x, .cy = (float)y, .text = (uint32_t)r->text_len,
+                        .x0 = x, .y0 = y, .x1 = x + n * SR_GLYPH_ADVANCE * s, .y1 = y + SR_GLYPH_H * s });
+    r->text_len += n + 1;
+}
+
+// n squares of side `size` centred on (x[i], y[i]) * k. Rather than one
+// command per dot, the dots are counting-sorted straight into per-tile runs
+// (a dot on a tile edge goes into each tile it touches) and every tile gets
+// a single SR_DOTS command.
+static void sr_dots(SoftRaster *r, const float *x, const float *y, int n, float size, float k, Color c) {
+    const int tiles = r->tiles_x * r->tiles_y;
+    const int side = CLAMP((int)(size * k + 0.5f), 1, 255);
+    const float bias = SR_DOT_BIAS + 0.5f - side * 0.5f;
+    if (n > r->corner_cap) {
+        r->corner_cap = n;
+        r->corner = realloc(r->corner, n * sizeof(SrDot));
+    }
+    // top-left corners in one pass; truncating a biased value rounds
+    // without a floorf call, and off-screen dots clamp to a harmless spot
+    SrDot *restrict at = r->corner;
+    const float lo = SR_DOT_BIAS - side, hx = SR_DOT_BIAS + r->w, hy = SR_DOT_BIAS + r->h;
+    for (int i = 0; i < n; ++i) {
+        float fx = CLAMP(x[i] * k + bias, lo, hx), fy = CLAMP(y[i] * k + bias, lo, hy);
+        at[i] = (SrDot){ (int16_t)((int)fx - SR_DOT_BIAS), (int16_t)((int)fy - SR_DOT_BIAS) };
+    }
+
+    int *fill = r->dot_fill;
+    memset(fill, 0, tiles * sizeof(int));
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int i = 0; i < n; ++i) {
+            int px = at[i].x, py = at[i].y;
+            if (px >= r->w || py >= r->h || px + side <= 0 || py + side <= 0) continue;
+            int tx0 = (px > 0 ? px : 0) / SR_TILE, tx1 = ((px + side < r->w ? px + side : r->w) - 1) / SR_TILE;
+            int ty0 = (py > 0 ? py : 0) / SR_TILE, ty1 = ((py + side < r->h ? py + side : r->h) - 1) / SR_TILE;
+            for (int ty = ty0; ty <= ty1; ++ty)
+                for (int tx = tx0; tx <= tx1; ++tx) {
+                    int t = ty * r->tiles_x + tx;
+                    if (pass) r->dots[fill[t]++] = at[i];
+                    else      fill[t]++;
+                }
+        }
+        if (pass) break;
+        // counts -> start offsets in the dot arena
+        int end = r->dot_len;
+        for (int t = 0; t < tiles; ++t) { int m = fill[t]; fill[t] = end; end += m; }
+        if (end > r->dot_cap) {
+            r->dot_cap = end * 2;
+            r->dots = realloc(r->dots, r->dot_cap * sizeof(SrDot));
+        }
+    }
+    // fill[] now holds where each run ends
+    uint32_t color = sr_pack(c);
+    for (int t = 0, start = r->dot_len; t < tiles; start = fill[t++]) {
+        if (fill[t] == start) continue;
+        int X0 = (t % r->tiles_x) * SR_TILE, Y0 = (t / r->tiles_x) * SR_TILE;
+        sr_push(r, (SrCmd){ .op = SR_DOTS, .scale = (uint8_t)side, .color = color,
+                            .text = (uint32_t)start, .count = (uint32_t)(fill[t] - start),
+                            .x0 = X0, .y0 = Y0, .x1 = X0 + SR_TILE, .y1 = Y0 + SR_TILE });
+    }
+    if (tiles) r->dot_len = fill[tiles - 1];
+}
+
+// Rasterize every recorded command; returns once the framebuffer is final.
+static void sr_flush(SoftRaster *r) {
+    atomic_store(&r->next_tile, 0);
+    pthread_mutex_lock(&r->lock);
+    r->busy = r->threads - 1;
+    r->generation++;
+    pthread_cond_broadcast(&r->wake);
+    pthread_mutex_unlock(&r->lock);
+    sr_raster_tiles(r);
+    pthread_mutex_lock(&r->lock);
+    while (r->busy) pthread_cond_wait(&r->done, &r->lock);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static bool sr_write_ppm(const SoftRaster *r, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+    fprintf(f, "P6\n%d %d\n255\n", r->w, r->h);
+    unsigned char *row = malloc((size_t)r->w * 3);
+    for (int y = 0; y < r->h; ++y) {
+        const unsigned char *src = (const unsigned char *)(r->pixels + (size_t)y * r->w);
+        for (int x = 0; x < r->w; ++x) {
+            row[x*3+0] = src[x*4+0]; row[x*3+1] = src[x*4+1]; row[x*3+2] = src[x*4+2];
+        }
+        fwrite(row, 3, r->w, f);
+    }
+    free(row);
+    fclose(f);
+    return true;
+}
+
+//--------------------------- draw layer ---------------------
+// Gameplay rendering goes through these so it can target either the
+// raylib window or the software rasterizer (headless benchmarks).
+//
+// The scene is drawn in arena units between gfx_scene_begin/end. On raylib
+// that lands in a RenderTexture of scene_w x scene_h, which is then
+// stretched over the letterboxed viewport; the HUD is drawn afterwards at
+// the window's own resolution. The software backend has no second target,
+// so it just scales scene coordinates into its framebuffer.
+typedef enum { GFX_RAYLIB, GFX_SOFT } GfxBackend;
+
+#define GFX_SCALE_MIN         0.25f
+#define GFX_SCALE_MAX         2.0f
+
+typedef struct {
+    float           scale;       // scene resolution relative to the viewport
+    Rectangle       viewport;    // where the arena sits in the window
+    RenderTexture2D target;
+    int             scene_w, scene_h;
+    float           zoom;        // scene pixels per arena unit
+    bool            in_scene;
+} GfxView;
+
+static GfxBackend  gfx_backend = GFX_RAYLIB;
+static SoftRaster  gfx_soft;
+static GfxView     gfx_view = { .scale = 1.0f, .zoom = 1.0f };
+
+static int gfx_width(void) {
+    return gfx_backend == GFX_SOFT ? gfx_soft.w : GetScreenWidth();
+}
+
+static int gfx_height(void) {
+    return gfx_backend == GFX_SOFT ? gfx_soft.h : GetScreenHeight();
+}
+
+// Largest arena-shaped rectangle centred in a w x h window.
+static Rectangle gfx_fit(int w, int h) {
+    float k = fminf((float)w / ARENA_W, (float)h / ARENA_H);
+    return (Rectangle){ (w - ARENA_W * k) / 2, (h - ARENA_H * k) / 2, ARENA_W * k, ARENA_H * k };
+}
+
+// Call once per frame before drawing: follows window resizes and `scale`
+// changes, recreating the scene target only when its size really changes.
+static void gfx_view_update(GfxView *v, float scale) {
+    v->viewport = gfx_fit(gfx_width(), gfx_height());
+    scale = CLAMP(scale, GFX_SCALE_MIN, GFX_SCALE_MAX);
+    int w = (int)fmaxf(1, roundf(v->viewport.width * scale));
+    int h = (int)fmaxf(1, roundf(v->viewport.height * scale));
+    v->zoom = (float)w / ARENA_W;
+    if (gfx_backend == GFX_SOFT || (w == v->scene_w && h == v->scene_h)) return;
+    if (v->scene_w) UnloadRenderTexture(v->target);
+    v->target  = LoadRenderTexture(w, h);
+    v->scene_w = w;
+    v->scene_h = h;
+    SetTextureFilter(v->target.texture, TEXTURE_FILTER_BILINEAR);
+}
+
+static void gfx_view_shutdown(GfxView *v) {
+    if (v->scene_w) UnloadRenderTexture(v->target);
+    v->scene_w = v->scene_h = 0;
+}
+
+static void gfx_clear(Color c) {
+    if (gfx_backend == GFX_SOFT) sr_clear(&gfx_soft, c);
+    else ClearBackground(c);
+}
+
+static void gfx_scene_begin(Color background) {
+    GfxView *v = &gfx_view;
+    v->in_scene = true;
+    if (gfx_backend == GFX_SOFT) {
+        v->zoom = fminf((float)gfx_soft.w / ARENA_W, (float)gfx_soft.h / ARENA_H);
+        return;
+    }
+    BeginTextureMode(v->target);
+    ClearBackground(background);
+    BeginMode2D((Camera2D){ .zoom = v->zoom });
+}
+
+static void gfx_scene_end(void) {
+    GfxView *v = &gfx_view;
+    v->in_scene = false;
+    if (gfx_backend == GFX_SOFT) return;
+    EndMode2D();
+    EndTextureMode();
+    // render textures are stored bottom-up
+    DrawTexturePro(v->target.texture, (Rectangle){ 0, 0, (float)v->scene_w, -(float)v->scene_h },
+                   v->viewport, (Vector2){ 0, 0 }, 0, WHITE);
+}
+
+// Software backend only; raylib applies the scene transform on the GPU.
+static inline float gfx_k(void) {
+    return gfx_view.in_scene ? gfx_view.zoom : 1.0f;
+}
+
+static void gfx_rect(Rectangle r, Color c) {
+    if (gfx_backend == GFX_SOFT) {
+        float k = gfx_k();
+        sr_rect(&gfx_soft, (Rectangle){ r.x * k, r.y * k, r.width * k, r.height * k }, c);
+    } else DrawRectangleRec(r, c);
+}
+
+static void gfx_circle(Vector2 p, float radius, Color c) {
+    if (gfx_backend == GFX_SOFT) {
+        float k = gfx_k();
+        sr_circle(&gfx_soft, (Vector2){ p.x * k, p.y * k }, radius * k, c);
+    } else DrawCircleV(p, radius, c);
+}
+
+// n squares of side `size` centred on (x[i], y[i]) as one batch: a single
+// quad stream on raylib (rlgl splits it only when its buffer fills), a
+// single binned pass on the software backend.
+static void gfx_dots(const float *x, const float *y, int n, float size, Color c) {
+    if (n <= 0) return;
+    if (gfx_backend == GFX_SOFT) {
+        sr_dots(&gfx_soft, x, y, n, size, gfx_k(), c);
+        return;
+    }
+    Texture2D tex = GetShapesTexture();
+    Rectangle src = GetShapesTextureRectangle();
+    const float h = size * 0.5f;
+    rlSetTexture(tex.id);
+    rlBegin(RL_QUADS);
+    rlColor4ub(c.r, c.g, c.b, c.a);
+    rlNormal3f(0, 0, 1);
+    rlTexCoord2f((src.x + src.width * 0.5f) / tex.width, (src.y + src.height * 0.5f) / tex.height);
+    for (int i = 0; i < n; ++i) {
+        rlVertex2f(x[i] - h, y[i] - h);
+        rlVertex2f(x[i] - h, y[i] + h);
+        rlVertex2f(x[i] + h, y[i] + h);
+        rlVertex2f(x[i] + h, y[i] - h);
+    }
+    rlEnd();
+    rlSetTexture(0);
+}
+
+static void gfx_text(const char *text, int x, int y, int size, Color c) {
+    if (gfx_backend == GFX_SOFT) {
+        float k = gfx_k();
+        sr_text(&gfx_soft, text, (int)(x * k), (int)(y * k), (int)(size * k), c);
+    } else DrawText(text, x, y, size, c);
+}
+
+// Same metrics as MeasureTextEx(GetFontDefault(), text, size, 0).
+static Vector2 gfx_measure(const char *text, int size) {
+    if (gfx_backend == GFX_SOFT) return sr_measure(text, size);
+    return MeasureTextEx(GetFontDefault(), text, size, 0);
+}
+
+//--------------------------- render -------------------------
+static void bullet_draw(Vector2 pos) {
+    gfx_circle(pos, BULLET_RADIUS, BLACK);
+}
+
+static void player_draw(const RenderSnapshot *s) {
+    gfx_rect(
+        (Rectangle){ s->player_pos.x - PLAYER_SIZE/2, s->player_pos.y - PLAYER_SIZE/2,
+                     PLAYER_SIZE, PLAYER_SIZE },
+        BLACK);
+    for (int i = 0; i < s->bullet_count; ++i) bullet_draw(s->bullets[i]);
+}
+
+static const Color enemy_colors[WAVE_TYPES] = {
+    [WAVE_CHASER] = GREEN, [WAVE_RING] = ORANGE, [WAVE_SPIRAL] = PURPLE, [WAVE_AIMED] = BLUE,
+};
+
+static void enemy_draw(const RenderSnapshot *s) {
+    for (int i = 0; i < s->enemy_count; ++i)
+        gfx_rect((Rectangle){ s->enemy_pos[i].x, s->enemy_pos[i].y, ENEMY_SIZE, ENEMY_SIZE },
+                 enemy_colors[s->enemy_kind[i]]);
+}
+
+static void draw_enemy_health(const RenderSnapshot *s, int index) {
+    Vector2 fsize=gfx_measure(TextFormat("%d", (int)s->enemy_health[index]), 5);
+    gfx_text(TextFormat("%d", (int)s->enemy_health[index]), s->enemy_pos[index].x-fsize.x*0.5f, s->enemy_pos[index].y-fsize.y-10, 5, BLACK);
+}
+
+void draw_powerup(const PowerUp* powerup, Vector2 pos){
+    char* type=" ";
+    char* rarity=" ";
+    Color color;
+    switch(powerup->type){
+        case HEAL:
+            type="HEAL";
+            break;
+        case FIRE_RATE:
             type="FIRE_RATE";
             break;
         case RELOAD_TIME:
@@ -528,156 +3150,942 @@ void draw_powerup(const PowerUp* powerup){
             color=BLUE;
             break;
     }
-    if(powerup->active){
-        Vector2 fsize=MeasureTextEx(GetFontDefault(), TextFormat("%s (%s)",type,rarity), 5, 0);
-        DrawText(TextFormat("%s (%s)",type,rarity),powerup->pos.x-powerup->size-fsize.x,powerup->pos.y-10-powerup->size,5,color);
+    Vector2 fsize=gfx_measure(TextFormat("%s (%s)",type,rarity), 5);
+    gfx_text(TextFormat("%s (%s)",type,rarity),pos.x-powerup->size-fsize.x,pos.y-10-powerup->size,5,color);
+}
+
+// Everything that lives in the arena, in arena units.
+static void render_scene(const RenderSnapshot *s) {
+    player_draw(s);
+    enemy_draw(s);
+    gfx_dots(s->shot_x, s->shot_y, s->shot_count, 2 * SHOT_RADIUS, RED);
+    int level = governor_level(), step = 1;
+    if (level >= QUALITY_NO_LABELS) step = 0;
+    else if (level >= QUALITY_FEW_LABELS) step = (s->enemy_count + GOV_LABEL_CAP - 1) / GOV_LABEL_CAP;
+    if (step > 0)
+        for (int i = 0; i < s->enemy_count; i += step) draw_enemy_health(s, i);
+    if(s->powerup_active){
+        gfx_circle(s->powerup_pos,s->powerup.size,s->powerup.color);
+        draw_powerup(&s->powerup, s->powerup_pos);
     }
 }
-int gameover=0;
+
+// Window pixels, anchored to the window's edges rather than the arena.
+static void render_hud(const RenderSnapshot *s) {
+    int right = gfx_width() - 200, bottom = gfx_height() - 70;
+    gfx_text(TextFormat("Wave: %d", s->wave), 10, 10, 20, BLACK);
+    gfx_text(TextFormat("Enemies: %d", s->alive), 10, 40, 20, BLACK);
+    gfx_text(TextFormat("Max Wave Enemies: %d", s->max_per_wave),
+            10, 70, 20, DARKGRAY);
+    gfx_text(TextFormat("total_kills: %d", s->kills),
+            10, 100, 20, DARKGRAY);
+    gfx_text(TextFormat("Enemy Spawn Time:%.2f",s->spawn_rate),10,130,20,DARKGRAY);
+    if (s->shot_count) gfx_text(TextFormat("Shots: %d", s->shot_count), 10, 160, 20, DARKGRAY);
+    if(s->wave_pending){
+        gfx_text(TextFormat("Next wave in: %.2f", s->wave_countdown),
+            gfx_width()/2 - (int)gfx_measure(TextFormat("Next wave in: %.2f", s->wave_countdown), 20).x/2,
+            10, 20, DARKGRAY);
+    }
+    gfx_text(TextFormat("Damage: %f", s->damage), right, 10, 20, BLACK);
+    gfx_text(TextFormat("Fire Rate: %.2f", s->fire_rate), right, 40, 20, BLACK);
+    gfx_text(TextFormat("Reload Time: %.2f", s->reload_time), right, 70, 20, BLACK);
+    gfx_text(TextFormat("Speed: %.2f", s->speed), right, 100, 20, BLACK);
+    gfx_text(TextFormat("Health: %d", s->health), right, bottom, 20, BLACK);
+
+    gfx_text(TextFormat("%d/%d",s->ammo,s->max_rounds),10,bottom,20,DARKGRAY);
+    if(s->reloading){
+        gfx_text("Reloading",20,bottom+40,20,DARKPURPLE);
+    }
+}
+
+// Scene resolution for this frame: the player's choice, halved by the governor.
+static float render_scale(void) {
+    return gfx_view.scale * (governor_level() >= QUALITY_HALF_RES ? 0.5f : 1.0f);
+}
+
+static void render_world(const RenderSnapshot *s) {
+    gfx_scene_begin(RAYWHITE);
+    render_scene(s);
+    gfx_scene_end();
+    render_hud(s);
+}
+
+//--------------------------- profiler -----------------------
+// F3 overlay over the last PROF_WINDOW rendered frames. Latency is input to
+// submit: from input_sample() to the frame that first shows its effect being
+// handed to EndDrawing, so it includes the sim queue and the snapshot
+// hand-off but not the buffer swap or the display.
+#define PROF_WINDOW           120
+
+typedef struct {
+    bool  visible;
+    int   count, head;
+    float frame_ms[PROF_WINDOW];
+    float submit_ms[PROF_WINDOW];     // input-to-submit latency
+} Profiler;
+
+static Profiler prof;
+
+static void profiler_record(Profiler *p, float frame_ms, float submit_ms) {
+    p->frame_ms[p->head]  = frame_ms;
+    p->submit_ms[p->head] = submit_ms;
+    p->head = (p->head + 1) % PROF_WINDOW;
+    if (p->count < PROF_WINDOW) p->count++;
+}
+
+static void profiler_stats(const float *v, int n, float *avg, float *max) {
+    float sum = 0, hi = 0;
+    for (int i = 0; i < n; ++i) { sum += v[i]; if (v[i] > hi) hi = v[i]; }
+    *avg = n ? sum / n : 0;
+    *max = hi;
+}
+
+static void profiler_draw(const Profiler *p) {
+    if (!p->visible) return;
+    float f_avg, f_max, l_avg, l_max;
+    profiler_stats(p->frame_ms, p->count, &f_avg, &f_max);
+    profiler_stats(p->submit_ms, p->count, &l_avg, &l_max);
+    int x = gfx_width() - 250, y = 140;
+    gfx_rect((Rectangle){ x - 5, y - 5, 240, 110 }, Fade(BLACK, 0.6f));
+    gfx_text(TextFormat("fps %d", f_avg > 0 ? (int)(1000.0f / f_avg) : 0), x, y, 10, WHITE);
+    gfx_text(TextFormat("frame   %5.2f ms  max %5.2f", f_avg, f_max), x, y + 20, 10, WHITE);
+    gfx_text(TextFormat("submit  %5.2f ms  max %5.2f", l_avg, l_max), x, y + 40, 10, WHITE);
+    gfx_text(TextFormat("quality %d  load %.2f", governor_level(), gov.load), x, y + 60, 10, WHITE);
+    gfx_text(TextFormat("scene   %dx%d  F4 scale %.2f", gfx_view.scene_w, gfx_view.scene_h, gfx_view.scale),
+             x, y + 80, 10, WHITE);
+}
+
+//--------------------------- assets -------------------------
+// Files are read and decoded on worker threads; only the device upload
+// (LoadSoundFromWave / LoadTextureFromImage) runs on the main thread,
+// spread over START-screen frames by assets_pump().
+#define ASSET_WORKERS         2
+
+typedef enum { ASSET_SOUND, ASSET_TEXTURE } AssetKind;
+typedef enum { ASSET_QUEUED, ASSET_DECODED, ASSET_READY, ASSET_FAILED } AssetState;
+
+typedef struct {
+    AssetKind   kind;
+    const char *path;
+    void       *target;          // Sound* or Texture2D*
+    bool        required;        // gates "Press enter"
+    union { Wave wave; Image image; } cpu;
+    _Atomic int state;
+} Asset;
+
+typedef struct {
+    Asset      *items;
+    int         count;
+    _Atomic int next;            // next item a worker claims
+    int         done;            // READY or FAILED, main thread only
+    pthread_t   workers[ASSET_WORKERS];
+    bool        joined;
+} AssetLoader;
+
+static Asset game_assets[] = {
+    { ASSET_SOUND, "../sound_effect/Shoot49.wav", &shooting_sound,   true },
+    { ASSET_SOUND, "../sound_effect/Hit24.wav",   &hit_sound,        true },
+    { ASSET_SOUND, "../sound_effect/PowerUp.wav", &powerup_sound,    true },
+    { ASSET_SOUND, "../sound_effect/Random2.wav", &death_sound,      true },
+    { ASSET_SOUND, "../sound_effect/Pickup6.wav", &count_down_sound, true },
+};
+
+static AssetLoader loader;
+
+static void *asset_worker(void *arg) {
+    AssetLoader *l = arg;
+    for (;;) {
+        int i = atomic_fetch_add(&l->next, 1);
+        if (i >= l->count) break;
+        Asset *a = &l->items[i];
+        bool ok = false;
+        switch (a->kind) {
+        case ASSET_SOUND:   a->cpu.wave  = LoadWave(a->path);  ok = IsWaveValid(a->cpu.wave);   break;
+        case ASSET_TEXTURE: a->cpu.image = LoadImage(a->path); ok = IsImageValid(a->cpu.image); break;
+        }
+        atomic_store_explicit(&a->state, ok ? ASSET_DECODED : ASSET_FAILED, memory_order_release);
+    }
+    return NULL;
+}
+
+static void assets_begin(AssetLoader *l, Asset *items, int count) {
+    *l = (AssetLoader){ .items = items, .count = count };
+    for (int i = 0; i < count; ++i) atomic_store(&items[i].state, ASSET_QUEUED);
+    for (int i = 0; i < ASSET_WORKERS; ++i) pthread_create(&l->workers[i], NULL, asset_worker, l);
+}
+
+// Main thread: upload whatever the workers have finished decoding.
+static void assets_pump(AssetLoader *l) {
+    if (l->joined) return;
+    l->done = 0;
+    for (int i = 0; i < l->count; ++i) {
+        Asset *a = &l->items[i];
+        int st = atomic_load_explicit(&a->state, memory_order_acquire);
+        if (st == ASSET_DECODED) {
+            switch (a->kind) {
+            case ASSET_SOUND:
+                *(Sound *)a->target = LoadSoundFromWave(a->cpu.wave);
+                UnloadWave(a->cpu.wave);
+                break;
+            case ASSET_TEXTURE:
+                *(Texture2D *)a->target = LoadTextureFromImage(a->cpu.image);
+                UnloadImage(a->cpu.image);
+                break;
+            }
+            atomic_store(&a->state, ASSET_READY);
+            st = ASSET_READY;
+        }
+        if (st == ASSET_READY || st == ASSET_FAILED) l->done++;
+    }
+    if (l->done == l->count) {
+        for (int i = 0; i < ASSET_WORKERS; ++i) pthread_join(l->workers[i], NULL);
+        l->joined = true;
+    }
+}
+
+static float assets_progress(const AssetLoader *l) {
+    return l->count ? (float)l->done / l->count : 1.0f;
+}
+
+// A failed asset does not block the game; its handle just stays empty.
+static bool assets_required_ready(const AssetLoader *l) {
+    for (int i = 0; i < l->count; ++i) {
+        int st = atomic_load(&l->items[i].state);
+        if (l->items[i].required && st != ASSET_READY && st != ASSET_FAILED) return false;
+    }
+    return true;
+}
+
+//--------------------------- benchmark ----------------------
+// Headless load test: no window, no audio. Keeps the arena topped up to a
+// fixed enemy count (and hostile shot count) and times simulation and
+// software rendering per tick.
+typedef struct {
+    int         enemies;
+    int         shots;           // hostile shots kept in the air
+    int         frames;
+    int         threads;         // rasterizer threads
+    bool        render;
+    bool        separation;      // crowd separation, off to time the bare kernels
+    bool        lod;             // distance-based update rates
+    int         quality;         // fixed governor level, -1 = let it decide
+    float       scale;           // framebuffer size relative to the arena
+    const char *ppm;             // dump every BENCH_PPM_EVERY frames when set
+} BenchOptions;
+
+#define BENCH_PPM_EVERY       60
+#define BENCH_SEEKS           200
+
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Prints the line and returns p99.
+static double bench_report(const char *name, double *ms, int n) {
+    if (n <= 0) return 0;
+    double sum = 0;
+    for (int i = 0; i < n; ++i) sum += ms[i];
+    qsort(ms, n, sizeof(double), cmp_double);
+    printf("  %-8s avg %7.3f ms   p50 %7.3f ms   p99 %7.3f ms   max %7.3f ms\n",
+           name, sum / n, ms[n / 2], ms[(int)(n * 0.99)], ms[n - 1]);
+    return ms[(int)(n * 0.99)];
+}
+
+// Revive dead enemies at random spawners so the load stays constant.
+static void bench_top_up(EnemyManager *em, int target) {
+    while (em->alive < target) {
+        if (em->ecs->spawn_count == ECS_MAX_SPAWNS) ecs_flush(em->ecs);
+        if (!enemy_add(em, (Vector2){ randf(0, ARENA_W), randf(0, ARENA_H) })) break;
+    }
+    ecs_flush(em->ecs);
+}
+
+// Rings from random points until the store holds `target` shots.
+static void bench_top_up_shots(ShotStore *s, int target) {
+    int queued = 0;
+    while (s->count + queued < target &&
+           shots_queue(s, (Vector2){ randf(0, ARENA_W), randf(0, ARENA_H) }, randf(0, 2 * PI), WAVE_RING))
+        queued += shot_patterns[WAVE_RING].shots;
+    shots_emit(s);
+}
+
+static int run_bench(const BenchOptions *o) {
+    World *w = calloc(1, sizeof(World));
+    RenderSnapshot *snap = calloc(1, sizeof(RenderSnapshot));
+    replay = calloc(1, sizeof(Replay));
+    world_init(w);
+    w->player.health        = 1 << 30;       // nobody dies during a benchmark
+    w->player.gun.damage    = 0;
+    w->enemies.max_per_wave = 0;             // no regular spawning
+    w->crowd.lod            = o->lod;
+    int target = CLAMP(o->enemies, 0, ENEMY_POOL);
+    int shots  = CLAMP(o->shots, 0, SHOT_POOL);
+    bench_top_up(&w->enemies, target);
+    bench_top_up_shots(&w->shots, shots);
+
+    if (o->render) {
+        gfx_backend = GFX_SOFT;
+        float k = CLAMP(o->scale, GFX_SCALE_MIN, GFX_SCALE_MAX);
+        sr_init(&gfx_soft, (int)(ARENA_W * k), (int)(ARENA_H * k), o->threads);
+    }
+    double *sim_ms = malloc(o->frames * sizeof(double));
+    double *ren_ms = malloc(o->frames * sizeof(double));
+    double *lat_ms = malloc(o->frames * sizeof(double));
+    double *rep_ms = malloc(o->frames * sizeof(double));
+    double shot_sum = 0;
+    int level_frames[QUALITY_LEVELS] = { 0 };
+    const float dt = 1.0f / SIM_HZ;
+    replay_reset(replay);
+    gov.forced = o->quality;
+
+    for (int f = 0; f < o->frames; ++f) {
+        float a = f * 0.05f;                 // strafe in a circle, sweep the aim
+        InputFrame in = { .move = { cosf(a), sinf(a) }, .fire = true,
+                          .mouse = { ARENA_W/2 + cosf(a * 3) * 300, ARENA_H/2 + sinf(a * 3) * 300 },
+                          .stamp = now_seconds() };
+        double t0 = now_seconds();
+        quality_apply(w, governor_level());
+        if (!o->separation) w->crowd.separate_every = 0;
+        world_step(w, &in, dt);
+        snapshot_capture(snap, w, (uint64_t)f);
+        snap->input_stamp = in.stamp;
+        double t1 = now_seconds();
+        replay_record(replay, snap);
+        rep_ms[f] = (now_seconds() - t1) * 1e3;
+        sim_ms[f] = (t1 - t0) * 1e3;
+        t1 = now_seconds();
+        if (o->render) {
+            gfx_clear(RAYWHITE);
+            render_world(snap);
+            sr_flush(&gfx_soft);
+        }
+        double t2 = now_seconds();       // frame is ready to submit
+        ren_ms[f] = (t2 - t1) * 1e3;
+        lat_ms[f] = (t2 - snap->input_stamp) * 1e3;
+        level_frames[governor_level()]++;
+        governor_update(&gov, (float)ren_ms[f], (float)sim_ms[f]);
+        if (o->render && o->ppm && f % BENCH_PPM_EVERY == 0) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s_%04d.ppm", o->ppm, f);
+            if (!sr_write_ppm(&gfx_soft, path)) fprintf(stderr, "bench: cannot write %s\n", path);
+        }
+        shot_sum += w->shots.count;
+        bench_top_up(&w->enemies, target);
+        bench_top_up_shots(&w->shots, shots);
+    }
+
+    printf("bench: %d enemies, %d ticks, renderer %s", target, o->frames,
+           o->render ? "soft" : "off");
+    if (o->render) printf(" %dx%d, %d thread(s)", gfx_soft.w, gfx_soft.h, gfx_soft.threads);
+    printf(", quality %s\n", o->quality < 0 ? "auto" : TextFormat("%d", governor_level()));
+    double sim_total = 0;
+    for (int f = 0; f < o->frames; ++f) sim_total += sim_ms[f];
+    printf("  enemies  %s layout, %d B/enemy%s%s, %.2f M enemy-ticks/s\n",
+           w->enemies.compact ? "compact" : "float",
+           ecs_row_bytes(&w->ecs, w->enemies.compact ? ENEMY_Q_SIG : ENEMY_SIG),
+           o->separation ? "" : ", no separation", o->lod ? "" : ", no lod",
+           sim_total > 0 ? (double)target * o->frames / sim_total * 1e-3 : 0.0);
+    if (o->quality < 0) {
+        printf("  frames per quality level:");
+        for (int l = 0; l < QUALITY_LEVELS; ++l) printf(" %d", level_frames[l]);
+        printf("\n");
+    }
+    if (shots)
+        printf("  shots    %.0f in the air on average, %.2f M shot-ticks/s\n", shot_sum / o->frames,
+               sim_total > 0 ? shot_sum / sim_total * 1e-3 : 0.0);
+    double sim_p99 = bench_report("sim", sim_ms, o->frames);
+    double ren_p99 = o->render ? bench_report("render", ren_ms, o->frames) : 0;
+    // sim and render run on their own threads, so each has its own budget
+    printf("  budget   sim p99 %.2f of %.2f ms", sim_p99, 1000.0 / SIM_HZ);
+    if (o->render) printf(", render p99 %.2f of %.2f ms", ren_p99, 1000.0 / 60);
+    printf(": %s 60 fps\n", sim_p99 <= 1000.0 / SIM_HZ && ren_p99 <= 1000.0 / 60 ? "holds" : "misses");
+    bench_report("submit", lat_ms, o->frames);
+    bench_report("replay", rep_ms, o->frames);
+    // cold seeks to random frames, as when the scrub bar is clicked
+    int seeks = replay->next > replay->first ? CLAMP(o->frames, 1, BENCH_SEEKS) : 0;
+    for (int k = 0; k < seeks; ++k) {
+        replay->dec_seq = UINT64_MAX;
+        uint64_t to = replay->first + rng_u32() % (replay->next - replay->first);
+        double t0 = now_seconds();
+        replay_seek(replay, to, snap);
+        rep_ms[k] = (now_seconds() - t0) * 1e3;
+    }
+    if (seeks) bench_report("seek", rep_ms, seeks);
+    printf("  replay   %.2f s held in %.1f MB\n", (double)(replay->next - replay->first) / SIM_HZ,
+           replay_bytes_held(replay) / (double)(1 << 20));
+
+    if (o->render) sr_shutdown(&gfx_soft);
+    free(sim_ms);
+    free(ren_ms);
+    free(lat_ms);
+    free(rep_ms);
+    free(replay);
+    replay = NULL;
+    free(snap);
+    free(w);
+    return 0;
+}
+
+//--------------------------- soak runner --------------------
+// Plays many headless games with a scripted bot across all cores and
+// aggregates per-wave balance and cost. Each run is seeded from its index,
+// so any line of the table can be replayed exactly.
+#define SOAK_MAX_WAVES        64
+#define SOAK_MAX_THREADS      64
+#define BOT_KITE_RADIUS       160.0f
+#define BOT_EDGE_MARGIN       60.0f
+
+typedef struct {
+    int      runs, threads;
+    float    max_minutes;        // game time cap per run
+    uint64_t seed;
+} SoakOptions;
+
+typedef struct {
+    uint32_t reached;            // runs that entered the wave
+    uint32_t died;               // runs that ended in it
+    uint64_t kills;
+    uint64_t ticks;
+    uint64_t enemy_ticks;        // sum of live enemies per tick
+    double   sim_seconds;        // wall time spent stepping this wave
+} SoakWave;
+
+typedef struct {
+    const SoakOptions *opt;
+    _Atomic int       *next_run;
+    SoakWave           waves[SOAK_MAX_WAVES];
+    uint64_t           ticks;
+    uint64_t           final_wave_sum;
+    int                final_wave_min, final_wave_max;
+    int                runs;
+    World             *world;
+} SoakWorker;
+
+static void bot_input(const World *w, InputFrame *in) {
+    const Player *p = &w->player;
+    *in = (InputFrame){ 0 };
+
+    Vector2 target = { 0 };
+    bool near = false;
+    float best = 1e30f;
+    for (EcsQuery q = ecs_query(&w->ecs, ENEMY_SIG); ecs_next(&q);) {
+        const Vector2 *pos = ECS_COL(&q, COMP_POS, Vector2);
+        for (int i = 0; i < q.count; ++i) {
+            float d = Vector2DistanceSqr(pos[i], p->pos);
+            if (d < best) { best = d; target = pos[i]; near = true; }
+        }
+    }
+    for (EcsQuery q = ecs_query(&w->ecs, ENEMY_Q_SIG); ecs_next(&q);) {
+        const QPos *pos = ECS_COL(&q, COMP_QPOS, QPos);
+        for (int i = 0; i < q.count; ++i) {
+            Vector2 e = { pos[i].x * (1.0f / QPOS_ONE), pos[i].y * (1.0f / QPOS_ONE) };
+            float d = Vector2DistanceSqr(e, p->pos);
+            if (d < best) { best = d; target = e; near = true; }
+        }
+    }
+
+    Vector2 move = { 0 };
+    if (ecs_alive(&w->ecs, w->powerup)) {
+        move = Vector2Subtract(*ECS_GET(&w->ecs, w->powerup, COMP_POS, Vector2), p->pos);  // grab it during the break
+    } else if (near && best < BOT_KITE_RADIUS * BOT_KITE_RADIUS) {
+        Vector2 away = Vector2Normalize(Vector2Subtract(p->pos, target));
+        move = (Vector2){ -away.y, away.x };                   // circle-strafe...
+        move = Vector2Add(move, away);                         // ...while backing off
+    }
+    // keep out of corners, where kiting stops working
+    if (p->pos.x < BOT_EDGE_MARGIN)         move.x += 1;
+    if (p->pos.x > ARENA_W - BOT_EDGE_MARGIN) move.x -= 1;
+    if (p->pos.y < BOT_EDGE_MARGIN)         move.y += 1;
+    if (p->pos.y > ARENA_H - BOT_EDGE_MARGIN) move.y -= 1;
+    in->move = move;
+
+    if (near) {
+        in->mouse = (Vector2){ target.x + ENEMY_SIZE/2, target.y + ENEMY_SIZE/2 };
+        in->fire  = true;
+    }
+}
+
+static void soak_play(SoakWorker *wk, int run) {
+    World *w = wk->world;
+    rng_seed(wk->opt->seed + (uint64_t)run);
+    world_init(w);
+    const float dt = 1.0f / SIM_HZ;
+    const uint64_t max_ticks = (uint64_t)(wk->opt->max_minutes * 60.0f * SIM_HZ);
+
+    int wave = -1;
+    for (uint64_t t = 0; t < max_ticks && !w->over; ++t) {
+        int cur = w->enemies.wave;
+        if (cur >= SOAK_MAX_WAVES) break;
+        if (cur != wave) { wave = cur; wk->waves[wave].reached++; }
+        uint32_t kills_before = (uint32_t)(w->enemies.total_enemies - w->enemies.alive);
+
+        InputFrame in;
+        bot_input(w, &in);
+        double t0 = now_seconds();
+        world_step(w, &in, dt);
+        double t1 = now_seconds();
+
+        SoakWave *sw = &wk->waves[wave];
+        sw->ticks++;
+        sw->enemy_ticks += (uint64_t)w->enemies.alive;
+        sw->sim_seconds += t1 - t0;
+        // enemy_wave_next resets the counters, so credit the kills before it
+        if (w->enemies.wave != wave) sw->kills += kills_before;
+        wk->ticks++;
+    }
+    if (wave >= 0 && wave < SOAK_MAX_WAVES && w->enemies.wave == wave) {
+        wk->waves[wave].kills += (uint64_t)(w->enemies.total_enemies - w->enemies.alive);
+        if (w->over) wk->waves[wave].died++;
+    }
+    int reached = w->enemies.wave;
+    wk->final_wave_sum += (uint64_t)reached;
+    if (!wk->runs || reached < wk->final_wave_min) wk->final_wave_min = reached;
+    if (!wk->runs || reached > wk->final_wave_max) wk->final_wave_max = reached;
+    wk->runs++;
+}
+
+static void *soak_worker(void *arg) {
+    SoakWorker *wk = arg;
+    wk->world = malloc(sizeof(World));
+    for (;;) {
+        int run = atomic_fetch_add(wk->next_run, 1);
+        if (run >= wk->opt->runs) break;
+        soak_play(wk, run);
+    }
+    free(wk->world);
+    return NULL;
+}
+
+static int run_soak(const SoakOptions *o) {
+    int threads = CLAMP(o->threads, 1, SOAK_MAX_THREADS);
+    _Atomic int next_run = 0;
+    SoakWorker *wk = calloc(threads, sizeof(SoakWorker));
+    pthread_t tid[SOAK_MAX_THREADS];
+
+    double t0 = now_seconds();
+    for (int i = 0; i < threads; ++i) {
+        wk[i].opt = o;
+        wk[i].next_run = &next_run;
+        pthread_create(&tid[i], NULL, soak_worker, &wk[i]);
+    }
+    for (int i = 0; i < threads; ++i) pthread_join(tid[i], NULL);
+    double wall = now_seconds() - t0;
+
+    SoakWave total[SOAK_MAX_WAVES] = { 0 };
+    uint64_t ticks = 0, wave_sum = 0;
+    int wave_min = 0, wave_max = 0, runs = 0;
+    for (int i = 0; i < threads; ++i) {
+        for (int k = 0; k < SOAK_MAX_WAVES; ++k) {
+            total[k].reached     += wk[i].waves[k].reached;
+            total[k].died        += wk[i].waves[k].died;
+            total[k].kills       += wk[i].waves[k].kills;
+            total[k].ticks       += wk[i].waves[k].ticks;
+            total[k].enemy_ticks += wk[i].waves[k].enemy_ticks;
+            total[k].sim_seconds += wk[i].waves[k].sim_seconds;
+        }
+        if (!wk[i].runs) continue;
+        if (!runs || wk[i].final_wave_min < wave_min) wave_min = wk[i].final_wave_min;
+        if (!runs || wk[i].final_wave_max > wave_max) wave_max = wk[i].final_wave_max;
+        ticks    += wk[i].ticks;
+        wave_sum += wk[i].final_wave_sum;
+        runs     += wk[i].runs;
+    }
+    free(wk);
+
+    double game_seconds = (double)ticks / SIM_HZ;
+    printf("soak: %d runs on %d thread(s), seed %llu, %.1f s wall, %.1f game-hours\n",
+           runs, threads, (unsigned long long)o->seed, wall, game_seconds / 3600.0);
+    printf("      %.0fx real time per core, final wave avg %.2f (min %d, max %d)\n",
+           game_seconds / (wall * threads), runs ? (double)wave_sum / runs : 0.0, wave_min, wave_max);
+    printf("\n wave  reached   died  avg kills  avg alive  sim us/tick  sim ms/wave\n");
+    for (int k = 0; k < SOAK_MAX_WAVES; ++k) {
+        const SoakWave *w = &total[k];
+        if (!w->reached) continue;
+        printf(" %4d  %7u  %5u  %9.1f  %9.1f  %11.2f  %11.2f\n", k, w->reached, w->died,
+               (double)w->kills / w->reached,
+               w->ticks ? (double)w->enemy_ticks / w->ticks : 0.0,
+               w->ticks ? w->sim_seconds * 1e6 / w->ticks : 0.0,
+               w->sim_seconds * 1e3 / w->reached);
+    }
+    return 0;
+}
+
+//--------------------------- menu --------------------------
+// The START countdown runs on its own wheel, stepped from frame time, so the
+// beeps and the hand-off to PLAYING are scheduled instead of polled.
+float start_time=3.0f;
+int start_pressed=0;
+static TimingWheel ui_timers;
+static float       ui_accum;
+static uint64_t    start_due;
+
+static void countdown_beep(TimingWheel *tw, void *ctx, uint32_t arg) {
+    PlaySound(count_down_sound);
+}
+
+static void countdown_done(TimingWheel *tw, void *ctx, uint32_t arg) {
+    enum Game *game = ctx;
+    sim_start(sim);
+    start_pressed=0;
+    *game=PLAYING;
+}
+
+static void start_countdown(enum Game *game) {
+    start_pressed=1;
+    start_due = ui_timers.now + secs_to_ticks(start_time);
+    for (int s = 1; s <= (int)start_time; ++s)
+        tw_schedule(&ui_timers, ui_timers.now + (uint64_t)s * SIM_HZ, countdown_beep, NULL, 0);
+    tw_schedule(&ui_timers, start_due, countdown_done, game, 0);
+}
+
+static void ui_timers_update(float dt) {
+    ui_accum += dt;
+    while (ui_accum >= 1.0f / SIM_HZ) {
+        ui_accum -= 1.0f / SIM_HZ;
+        tw_advance(&ui_timers);
+    }
+}
+
+//--------------------------- kill-cam -----------------------
+// END screen: replays the last KILLCAM_SECONDS at KILLCAM_SPEED and holds
+// the final frame. Left/Right scrub (Shift for 4x), the bar at the bottom
+// can be clicked or dragged, Space plays/pauses, Home goes to the oldest
+// frame still held.
+#define KILLCAM_SECONDS       3.0f
+#define KILLCAM_SPEED         0.5f
+#define KILLCAM_BAR_H         12
+
+typedef struct {
+    double pos;                  // replay frame sequence, fractional while playing
+    bool   playing;
+} KillCam;
+
+static KillCam         killcam;
+static RenderSnapshot *killcam_snap;  // allocated with the windowed game's sim
+
+static Rectangle killcam_bar(void) {
+    return (Rectangle){ 20, GetScreenHeight() - 30, GetScreenWidth() - 40, KILLCAM_BAR_H };
+}
+
+static void killcam_start(KillCam *k, const Replay *r) {
+    double last = r->next ? (double)(r->next - 1) : 0;
+    k->pos     = fmax((double)r->first, last - KILLCAM_SECONDS * SIM_HZ);
+    k->playing = true;
+}
+
+static void killcam_update(KillCam *k, const Replay *r, float dt) {
+    if (r->first == r->next) return;
+    double first = (double)r->first, last = (double)(r->next - 1);
+    if (IsKeyPressed(KEY_SPACE)) {
+        k->playing = !k->playing;
+        if (k->playing && k->pos >= last) k->pos = first;
+    }
+    if (IsKeyPressed(KEY_HOME)) k->pos = first;
+    float scrub = (float)(IsKeyDown(KEY_RIGHT) - IsKeyDown(KEY_LEFT)) * (IsKeyDown(KEY_LEFT_SHIFT) ? 4 : 1);
+    if (scrub != 0) k->playing = false;
+    k->pos += (scrub + (k->playing ? KILLCAM_SPEED : 0)) * dt * SIM_HZ;
+    Rectangle bar = killcam_bar();
+    Vector2 m = GetMousePosition();
+    if (IsMouseButtonDown(MOUSE_BUTTON_LEFT) && m.y >= bar.y - 10 && m.y <= bar.y + bar.height + 10) {
+        k->pos = first + (last - first) * CLAMP((m.x - bar.x) / bar.width, 0, 1);
+        k->playing = false;
+    }
+    if (k->pos >= last) { k->pos = last; k->playing = false; }
+    if (k->pos < first) k->pos = first;
+}
+
+// Scene only: the HUD of a past frame would just cover the view.
+static void killcam_draw(const KillCam *k, Replay *r) {
+    if (!replay_seek(r, (uint64_t)k->pos, killcam_snap)) return;
+    gfx_scene_begin(RAYWHITE);
+    render_scene(killcam_snap);
+    gfx_scene_end();
+    Rectangle bar = killcam_bar();
+    double span = (double)(r->next - 1 - r->first);
+    float t = span > 0 ? (float)((k->pos - r->first) / span) : 1;
+    DrawRectangleRec(bar, Fade(BLACK, 0.2f));
+    DrawRectangle(bar.x, bar.y, bar.width * t, bar.height, DARKGRAY);
+    DrawText(TextFormat("%s %+.2f s", k->playing ? "kill-cam" : "paused",
+                        -(float)((r->next - 1) - k->pos) / SIM_HZ),
+             bar.x, bar.y - 22, 20, DARKGRAY);
+}
+
+//--------------------------- idle screens -------------------
+// START, END and PAUSED only change on input, on a ui timer or while assets
+// load. Each frame they describe what they would draw as an IdleKey; if it
+// matches the frame already on screen, drawing is skipped and the loop
+// parks in idle_wait: on window events alone when nothing is scheduled,
+// otherwise until the next change is due.
+#define IDLE_POLL_S           0.1     // longest timed sleep, keeps closing responsive
+#define IDLE_LOAD_S           (1.0 / 60)
+
+typedef struct {
+    int game, width, height;
+    int a, b;                    // per screen: progress, countdown, replay frame...
+} IdleKey;
+
+static IdleKey idle_shown;
+
+static bool idle_redraw(IdleKey key) {
+    if (!memcmp(&key, &idle_shown, sizeof(key))) return false;
+    idle_shown = key;
+    return true;
+}
+
+// Whatever else draws over the window makes the next idle frame stale.
+static void idle_forget(void) {
+    idle_shown.game = -1;
+}
+
+// Stands in for the EndDrawing a skipped frame did not run: sleeps until
+// `wake` (now_seconds() clock, INFINITY = input only) and polls input once.
+static void idle_wait(double wake) {
+    if (isinf(wake)) {
+        EnableEventWaiting();
+        PollInputEvents();           // blocks in glfwWaitEvents
+        DisableEventWaiting();
+        return;
+    }
+    sleep_until(fmin(wake, now_seconds() + IDLE_POLL_S));
+    PollInputEvents();
+}
+
+// Process CPU time (every thread) against wall time per state, logged at
+// exit so idle screens can be checked on the machine that runs them.
+static const char *game_state_name[GAME_STATES] = { "START", "PLAYING", "END", "PAUSED" };
+static double cpu_used[GAME_STATES], cpu_wall[GAME_STATES];
+static double cpu_mark_cpu, cpu_mark_wall;
+static int    cpu_state = -1;
+
+static double cpu_seconds(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1e-6;
+}
+
+// Charges the time since the last call to the state it ran in.
+static void cpu_meter(int game) {
+    double c = cpu_seconds(), w = now_seconds();
+    if (cpu_state >= 0) {
+        cpu_used[cpu_state] += c - cpu_mark_cpu;
+        cpu_wall[cpu_state] += w - cpu_mark_wall;
+    }
+    cpu_state = game;
+    cpu_mark_cpu = c;
+    cpu_mark_wall = w;
+}
+
+static void cpu_report(void) {
+    for (int g = 0; g < GAME_STATES; ++g)
+        if (cpu_wall[g] > 0)
+            TraceLog(LOG_INFO, "CPU: %-7s %5.1f%% of a core over %.1f s", game_state_name[g],
+                     100 * cpu_used[g] / cpu_wall[g], cpu_wall[g]);
+}
 
 //--------------------------- game loop ----------------------
-int main(void) {
-    InitWindow(SCR_W, SCR_H, "Shooter");
+int main(int argc, char **argv) {
+    bool bench = false, soak = false;
+    const char *telemetry = NULL;
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    BenchOptions bo = { .enemies = 10000, .frames = 600, .render = true, .threads = cores,
+                        .separation = true, .lod = true, .scale = 1.0f,
+                        .quality = QUALITY_FULL };
+    SoakOptions  so = { .runs = 256, .threads = cores, .max_minutes = 30, .seed = 1 };
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i], *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(arg, "--telemetry"))
+            telemetry = val && val[0] != '-' ? argv[++i] : "telemetry";
+        else if (!strcmp(arg, "--bench"))            bench = true;
+        else if (!strcmp(arg, "--enemies") && val)   bo.enemies = atoi(argv[++i]);
+        else if (!strcmp(arg, "--shots") && val)     bo.shots   = atoi(argv[++i]);
+        else if (!strcmp(arg, "--frames") && val)    bo.frames  = atoi(argv[++i]);
+        else if (!strcmp(arg, "--threads") && val)   bo.threads = so.threads = atoi(argv[++i]);
+        else if (!strcmp(arg, "--soak"))             soak = true;
+        else if (!strcmp(arg, "--runs") && val)      so.runs = atoi(argv[++i]);
+        else if (!strcmp(arg, "--minutes") && val)   so.max_minutes = (float)atof(argv[++i]);
+        else if (!strcmp(arg, "--seed") && val)      so.seed = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(arg, "--ppm") && val)       bo.ppm     = argv[++i];
+        else if (!strcmp(arg, "--no-render"))        bo.render  = false;
+        else if (!strcmp(arg, "--no-separation"))    bo.separation = false;
+        else if (!strcmp(arg, "--no-lod"))           bo.lod = false;
+        else if (!strcmp(arg, "--compact"))          compact_enemies = true;
+        else if (!strcmp(arg, "--waves") && val) {
+            if (!wave_file_open(&wave_file, argv[++i])) return 1;
+        }
+        else if (!strcmp(arg, "--render-scale") && val)
+            bo.scale = gfx_view.scale = (float)atof(argv[++i]);
+        else if (!strcmp(arg, "--quality") && val) {
+            const char *level = argv[++i];
+            bo.quality = strcmp(level, "auto") ? atoi(level) : -1;
+        }
+    }
+    if (bench && bo.frames < 1) {
+        fprintf(stderr, "bench: --frames must be at least 1\n");
+        return 1;
+    }
+    if (soak) {
+        // soak workers would all push into the one single-producer sim channel
+        if (telemetry) TraceLog(LOG_WARNING, "TELEMETRY: not recorded by --soak");
+        int rc = run_soak(&so);
+        telemetry_stop();
+        wave_file_close(&wave_file);
+        return rc;
+    }
+    if (telemetry) telemetry_start(telemetry);
+    if (bench) {
+        rng_seed(1);
+        int rc = run_bench(&bo);
+        telemetry_stop();
+        wave_file_close(&wave_file);
+        return rc;
+    }
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+    InitWindow(WINDOW_W, WINDOW_H, "Shooter");
     SetTargetFPS(60);
     InitAudioDevice();
-    shooting_sound=LoadSound("../sound_effect/Shoot49.wav");
-    hit_sound=LoadSound("../sound_effect/Hit24.wav");
-    powerup_sound=LoadSound("../sound_effect/PowerUp.wav");
-    death_sound=LoadSound("../sound_effect/Random2.wav");
-    count_down_sound=LoadSound("../sound_effect/Pickup6.wav");
-    srand((unsigned)time(NULL));
+    assets_begin(&loader, game_assets, sizeof(game_assets)/sizeof(game_assets[0]));
+    rng_seed((uint64_t)time(NULL));
+    sim          = sim_create();
+    replay       = calloc(1, sizeof(Replay));
+    killcam_snap = calloc(1, sizeof(RenderSnapshot));
     enum Game game = START;
-    Player       player;      player_init(&player);
-    EnemyManager enemies;     enemy_manager_init(&enemies);
-    PowerUp     powerup;
-    float count_time=1;
-    float count_timer=0;
+    tw_init(&ui_timers);
+    uint64_t frame = 0;
+    double last = now_seconds();
     while (!WindowShouldClose()) {
-        float dt = GetFrameTime();
+        double t = now_seconds();
+        float dt = (float)(t - last);    // GetFrameTime misses skipped frames
+        last = t;
+        frame++;
+        cpu_meter(game);
+        ui_timers_update(dt);
+        int sw = GetScreenWidth(), sh = GetScreenHeight();
+        Vector2 fsize;
         switch (game)
         {
-        case START:
-            
+        case START: {
+            assets_pump(&loader);
+            bool assets_ready = assets_required_ready(&loader);
+            if(IsKeyPressed(KEY_ENTER) && assets_ready && !start_pressed){
+                start_countdown(&game);
+            }
+            float progress = assets_progress(&loader);
+            uint64_t due = start_due > ui_timers.now ? start_due - ui_timers.now : 0;
+            int left = start_pressed ? (int)((due + SIM_HZ - 1) / SIM_HZ) : 0;
+            IdleKey key = { START, sw, sh, assets_ready ? 1000 : (int)(progress * 1000), left };
+            if (!idle_redraw(key)) {
+                double wake = INFINITY;
+                if (!assets_ready) wake = t + IDLE_LOAD_S;
+                else if (start_pressed)              // when the digit changes
+                    wake = t + (double)(due - (uint64_t)(left - 1) * SIM_HZ) / SIM_HZ - ui_accum;
+                idle_wait(wake);
+                break;
+            }
             BeginDrawing();
             ClearBackground(RAYWHITE);
-            int fw, fh;
-            Vector2 fsize = MeasureTextEx(GetFontDefault(), "Shooter", 80, 0);
-            DrawText("Shooter", (SCR_W-fsize.x)/2, 10+fsize.y, 80, BLACK); 
-            EndDrawing();
-            if(IsKeyPressed(KEY_ENTER)){
-                start_pressed=1;
-            }
-            if(start_pressed){
-                start_timer+=dt;
-                count_timer+=dt;
-                if(count_timer>=count_time){
-                    PlaySound(count_down_sound);
-                    //count_time+=1;
-                    count_timer=0;
-                }
-                fsize=MeasureTextEx(GetFontDefault(), TextFormat("%d", (int)(start_time-start_timer)), 50, 0);
-                DrawText(TextFormat("%d", (int)ceil((start_time-start_timer))), (SCR_W-fsize.x)/2, 300+fsize.y, 50, BLACK);
+            fsize = MeasureTextEx(GetFontDefault(), "Shooter", 80, 0);
+            DrawText("Shooter", (sw-fsize.x)/2, 10+fsize.y, 80, BLACK); 
+            if(!assets_ready){
+                float w = 300;
+                DrawText("Loading...", (sw-MeasureText("Loading...", 20))/2, sh/2, 20, DARKGRAY);
+                DrawRectangleLines((sw-w)/2, sh/2+30, w, 16, DARKGRAY);
+                DrawRectangle((sw-w)/2 + 2, sh/2+32, (w-4)*progress, 12, DARKGRAY);
+            }else if(start_pressed){
+                fsize=MeasureTextEx(GetFontDefault(), TextFormat("%d", left), 50, 0);
+                DrawText(TextFormat("%d", left), (sw-fsize.x)/2, sh/2+fsize.y, 50, BLACK);
                 
             }else{
                 fsize=MeasureTextEx(GetFontDefault(), "Press enter to start", 20, 0);
-                DrawText("Press enter to start", (SCR_W-fsize.x)/2, 300+fsize.y, 20, BLACK);
-            }
-            
-            if(start_timer>=start_time){
-                enemy_manager_init(&enemies);
-                player_init(&player);
-                start_pressed=0;
-                game=PLAYING;
+                DrawText("Press enter to start", (sw-fsize.x)/2, sh/2+fsize.y, 20, BLACK);
             }
-            
+            EndDrawing();
             break;
-        case PLAYING:
-                //--- update
-            pickup_powerup(&powerup,&player);
-            player_update(&player, dt);
-            enemy_manager_update(&enemies, &player, dt);
-            enemy_wave_update(&enemies, dt);
-            for(int i=0;i<ENEMY_POOL;i++){
-                if(!enemies.e[i].active)continue;
-                for(int j=i+1;j<ENEMY_POOL;j++){
-                    if(!enemies.e[i].active||!enemies.e[j].active)continue;
-                    enemy_selfcollide(&enemies.e[i],&enemies.e[j]);
-                }
-                draw_enemy_health(&enemies,i);
+        }
+        case PLAYING: {
+            double frame_start = now_seconds();
+            if(IsKeyPressed(KEY_F3)) prof.visible = !prof.visible;
+            if(IsKeyPressed(KEY_F4)) gfx_view.scale = gfx_view.scale > 0.5f ? gfx_view.scale - 0.25f : 1.0f;
+            if(IsKeyPressed(KEY_P)){
+                sim_pause(sim, true);
+                game=PAUSED;
+                idle_wait(now_seconds());        // no EndDrawing this pass: poll so P is released
+                break;
             }
-            
-            //--- draw
-            BeginDrawing();
-            ClearBackground(RAYWHITE);
+            gfx_view_update(&gfx_view, render_scale());
+            InputFrame in = input_sample(gfx_view.viewport);
+            spsc_push(&sim->input, &in);          // sim falls back to last input if full
+            const RenderSnapshot *snap = tb_latest(&sim->snapshots);
 
-            player_draw(&player);
-            enemy_draw(&enemies);
-
-            DrawText(TextFormat("Wave: %d", enemies.wave), 10, 10, 20, BLACK);
-            DrawText(TextFormat("Enemies: %d", enemies.alive), 10, 40, 20, BLACK);
-            DrawText(TextFormat("Max Wave Enemies: %d", enemies.max_per_wave), 
-                    10, 70, 20, DARKGRAY);
-            DrawText(TextFormat("total_kills: %d", (int)enemies.total_enemies-enemies.alive), 
-                    10, 100, 20, DARKGRAY);
-            DrawText(TextFormat("Enemy Spawn Time:%.2f",enemies.spawnRate),10,130,20,DARKGRAY);
-            if(enemies.wavePending){
-                if(powerup_active==0){
-                    set_powerup(&powerup);
-                    powerup_active=1;
-                }
-                
-                DrawText(TextFormat("Next wave in: %.2f", enemies.wavePending ? enemies.waveDelay - enemies.waveTimer : 0), 
-                    GetScreenWidth()/2 - MeasureText(TextFormat("Next wave in: %.2f", enemies.wavePending ? enemies.waveDelay - enemies.waveTimer : 0), 20)/2, 
-                    10, 20, DARKGRAY);
-            }else{
-                powerup_active=0;
-                powerup.active=0;
-            }
-            DrawText(TextFormat("Damage: %f", player.gun.damage), 600, 10, 20, BLACK);
-            DrawText(TextFormat("Fire Rate: %.2f", player.gun.fireRate), 600, 40, 20, BLACK);
-            DrawText(TextFormat("Reload Time: %.2f", player.gun.reloadTime), 600, 70, 20, BLACK);
-            // DrawText(TextFormat("Bullet Speed: %.2f", player.gun.bulletSpeed), 600, 100, 20, BLACK);
-            DrawText(TextFormat("Speed: %.2f", player.speed), 600, 100, 20, BLACK);
-            DrawText(TextFormat("Health: %d", player.health), 600, 530, 20, BLACK);
-            
-            DrawText(TextFormat("%d/%d",player.gun.ammo,player.gun.max_rounds),10,530,20,DARKGRAY);
-            if(player.gun.reloading==1){
-                DrawText("Reloading",20,570,20,DARKPURPLE);
-            }
-            if(powerup.active){
-                DrawCircle(powerup.pos.x,powerup.pos.y,powerup.size,powerup.color);
-            }
+            BeginDrawing();
+            ClearBackground(LIGHTGRAY);          // letterbox bars
+            render_world(snap);
+            profiler_draw(&prof);
+            double submit = now_seconds();       // before the swap and the FPS limiter's wait
             EndDrawing();
-            if(player.health<=0){
+            idle_forget();
+            float latency = snap->input_stamp > 0 ? (float)((submit - snap->input_stamp) * 1e3) : 0;
+            profiler_record(&prof, dt * 1e3f, latency);
+            telemetry_stamp(TELEM_RENDER, (uint32_t)frame);
+            telemetry_emit(TELEM_RENDER, TELEM_FRAME, (uint16_t)governor_level(), dt * 1e3f,
+                           (uint32_t)(latency * 1e3f));
+            governor_update(&gov, (float)((submit - frame_start) * 1e3), snap->sim_ms);
+            if(snap->over){
+                sim_stop(sim);
                 game=END;
             }
-            if(IsKeyPressed(KEY_Q)){
-                game=END;
+            break;
+        }
+        case PAUSED: {
+            if(IsKeyPressed(KEY_P)){
+                sim_pause(sim, false);
+                game=PLAYING;
+                idle_wait(now_seconds());
+                break;
             }
-            if(powerup.active){
-                draw_powerup(&powerup);
+            if (!idle_redraw((IdleKey){ PAUSED, sw, sh })) {
+                idle_wait(INFINITY);
+                break;
             }
-            player_limit_movement(&player);
+            gfx_view_update(&gfx_view, render_scale());
+            BeginDrawing();
+            ClearBackground(LIGHTGRAY);
+            render_world(tb_latest(&sim->snapshots));
+            DrawRectangle(0, 0, sw, sh, Fade(RAYWHITE, 0.6f));
+            fsize=MeasureTextEx(GetFontDefault(), "Paused", 50, 0);
+            DrawText("Paused", (sw-fsize.x)/2, sh/2-fsize.y, 50, BLACK);
+            fsize=MeasureTextEx(GetFontDefault(), "Press P to resume", 20, 0);
+            DrawText("Press P to resume", (sw-fsize.x)/2, sh/2+10, 20, BLACK);
+            EndDrawing();
             break;
+        }
         case END:
-            BeginDrawing();
             if(!gameover){
                 PlaySound(death_sound);
+                killcam_start(&killcam, replay);
                 gameover=1;
             }
-            
-            ClearBackground(RAYWHITE);
-            fsize=MeasureTextEx(GetFontDefault(), "Game Over", 50, 0);
-            DrawText("Game Over", SCR_W/2-fsize.x/2, SCR_H/2-fsize.y/2, 50, BLACK);
-            fsize=MeasureTextEx(GetFontDefault(), "Press Enter to play again", 50, 0);
-            DrawText("Press Enter to play again", SCR_W/2-fsize.x/2, SCR_H/2+fsize.y/2, 50, BLACK);
             if(IsKeyPressed(KEY_ENTER)){
-                start_timer=0;
-                start_pressed=1;
+                start_countdown(&game);
                 gameover=0;
                 game=START;
-                
+                idle_wait(now_seconds());
+                break;
             }
+            killcam_update(&killcam, replay, fminf(dt, 0.1f));  // no jump after a long wait
+            if (!idle_redraw((IdleKey){ END, sw, sh, (int)(killcam.pos * 16), killcam.playing })) {
+                idle_wait(INFINITY);
+                break;
+            }
+            gfx_view_update(&gfx_view, render_scale());
+            BeginDrawing();
+            ClearBackground(LIGHTGRAY);
+            killcam_draw(&killcam, replay);
+            fsize=MeasureTextEx(GetFontDefault(), "Game Over", 50, 0);
+            DrawText("Game Over", sw/2-fsize.x/2, sh/4-fsize.y/2, 50, BLACK);
+            fsize=MeasureTextEx(GetFontDefault(), "Press Enter to play again", 50, 0);
+            DrawText("Press Enter to play again", sw/2-fsize.x/2, sh/4+fsize.y/2, 50, BLACK);
             EndDrawing();
             break;
         default:
@@ -686,6 +4094,12 @@ int main(void) {
         
     }
 
+    cpu_meter(game);
+    cpu_report();
+    sim_stop(sim);
+    telemetry_stop();
+    wave_file_close(&wave_file);
+    gfx_view_shutdown(&gfx_view);
     CloseWindow();
     return 0;
 }
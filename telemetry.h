@@ -0,0 +1,41 @@
+//------------------------------------------------------------
+// telemetry.h – on-disk format shared by the game and tools/
+//------------------------------------------------------------
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+#define TELEM_MAGIC           "TLM1"
+#define TELEM_VERSION         1
+
+// Every log file starts with this header, followed by packed records.
+typedef struct {
+    char     magic[4];
+    uint32_t version;
+    uint32_t record_size;        // sizeof(TelemetryRecord)
+    uint32_t sim_hz;
+    uint64_t sequence;           // increases by one per rotated file
+} TelemetryHeader;
+
+typedef enum {
+    TELEM_RUN_START = 1,         // a: -        v0: -               v1: -
+    TELEM_RUN_END,               // a: wave     v0: run seconds     v1: total kills
+    TELEM_FRAME,                 // a: quality  v0: frame ms        v1: input-to-submit us
+    TELEM_TICK,                  // a: enemies  v0: tick cost ms    v1: bullets alive
+    TELEM_WAVE,                  // a: new wave v0: new spawn rate  v1: kills last wave
+    TELEM_POWERUP,               // a: type     v0: -               v1: rarity
+    TELEM_QUALITY,               // a: level    v0: smoothed load   v1: previous level
+} TelemetryKind;
+
+// Fixed 16-byte record; `tick` is the sim tick for sim records and the
+// frame counter for render records.
+typedef struct {
+    uint32_t tick;
+    uint16_t kind;
+    uint16_t a;
+    float    v0;
+    uint32_t v1;
+} TelemetryRecord;
+
+#endif
@@ -0,0 +1,79 @@
+//------------------------------------------------------------
+// telemetry2csv – convert game telemetry logs to CSV
+//   usage: telemetry2csv telemetry.0.bin [telemetry.1.bin ...] > out.csv
+// Files are emitted in header sequence order, so passing a whole rotated
+// set (telemetry.*.bin) yields one chronological table.
+//------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../telemetry.h"
+
+typedef struct {
+    const char     *path;
+    TelemetryHeader header;
+} LogFile;
+
+static const char *kind_name(uint16_t kind) {
+    switch (kind) {
+        case TELEM_RUN_START: return "run_start";
+        case TELEM_RUN_END:   return "run_end";
+        case TELEM_FRAME:     return "frame";
+        case TELEM_TICK:      return "tick";
+        case TELEM_WAVE:      return "wave";
+        case TELEM_POWERUP:   return "powerup";
+        case TELEM_QUALITY:   return "quality";
+        default:              return "unknown";
+    }
+}
+
+static int read_header(LogFile *lf) {
+    FILE *f = fopen(lf->path, "rb");
+    if (!f) { fprintf(stderr, "telemetry2csv: cannot open %s\n", lf->path); return 0; }
+    size_t n = fread(&lf->header, sizeof(lf->header), 1, f);
+    fclose(f);
+    if (n != 1 || memcmp(lf->header.magic, TELEM_MAGIC, 4) != 0 ||
+        lf->header.record_size != sizeof(TelemetryRecord)) {
+        fprintf(stderr, "telemetry2csv: %s is not a v%d telemetry log\n", lf->path, TELEM_VERSION);
+        return 0;
+    }
+    return 1;
+}
+
+static int by_sequence(const void *a, const void *b) {
+    uint64_t x = ((const LogFile *)a)->header.sequence, y = ((const LogFile *)b)->header.sequence;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s telemetry.N.bin [...]\n", argv[0]);
+        return 1;
+    }
+    LogFile *files = calloc(argc - 1, sizeof(LogFile));
+    int count = 0;
+    for (int i = 1; i < argc; ++i) {
+        files[count].path = argv[i];
+        if (read_header(&files[count])) count++;
+    }
+    qsort(files, count, sizeof(LogFile), by_sequence);
+
+    printf("file_seq,tick,kind,a,v0,v1\n");
+    TelemetryRecord batch[1024];
+    for (int i = 0; i < count; ++i) {
+        FILE *f = fopen(files[i].path, "rb");
+        if (!f) continue;
+        fseek(f, sizeof(TelemetryHeader), SEEK_SET);
+        size_t n;
+        while ((n = fread(batch, sizeof(TelemetryRecord), 1024, f)) > 0) {
+            for (size_t k = 0; k < n; ++k) {
+                const TelemetryRecord *r = &batch[k];
+                printf("%llu,%u,%s,%u,%g,%u\n", (unsigned long long)files[i].header.sequence,
+                       r->tick, kind_name(r->kind), r->a, r->v0, r->v1);
+            }
+        }
+        fclose(f);
+    }
+    free(files);
+    return count ? 0 : 1;
+}
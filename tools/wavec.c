@@ -0,0 +1,219 @@
+//------------------------------------------------------------
+// wavec – compile a text wave script into the game's binary wave file
+//   usage: wavec waves.txt waves.bin
+//
+//   # comment
+//   spawner north 400 0          named spawn point, arena units
+//   wave break 5                 new wave; seconds of pause once cleared
+//   at 0 spawn 200 north over 3 hp 200 speed 100
+//   at 4 spawn 1 random type spiral hp 5000 speed 60
+//
+// `at` is seconds from the start of the wave; `over` spreads the spawns
+// evenly across that many seconds. hp and speed default to 200 and 100,
+// type (chaser, ring, spiral, aimed or its number) to chaser. Without
+// spawner lines the game uses its built-in ones and spawners are given by
+// index. Events of each wave are sorted by time.
+//------------------------------------------------------------
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../waves.h"
+
+#define MAX_SPAWNERS          256
+#define MAX_WORDS             16
+#define DEFAULT_BREAK_S       5.0f
+#define DEFAULT_HP            200.0f
+#define DEFAULT_SPEED         100.0f
+
+typedef struct {
+    char        name[32];
+    WaveSpawner pos;
+} Spawner;
+
+typedef struct {
+    WaveEvent e;
+    uint64_t  order;             // keeps equal times in source order
+} Pending;
+
+static const char *src_path;
+static int         src_line;
+
+static void fail(const char *msg, const char *arg) {
+    fprintf(stderr, "%s:%d: %s%s%s\n", src_path, src_line, msg, arg ? " " : "", arg ? arg : "");
+    exit(1);
+}
+
+static float parse_float(const char *s) {
+    char *end;
+    float v = strtof(s, &end);
+    if (end == s || *end) fail("expected a number, got", s);
+    return v;
+}
+
+static int parse_type(const char *s) {
+    static const char *names[WAVE_TYPES] = { "chaser", "ring", "spiral", "aimed" };
+    for (int t = 0; t < WAVE_TYPES; ++t)
+        if (!strcmp(s, names[t])) return t;
+    return (int)parse_float(s);
+}
+
+static int by_time(const void *a, const void *b) {
+    const Pending *x = a, *y = b;
+    if (x->e.ms != y->e.ms) return x->e.ms < y->e.ms ? -1 : 1;
+    return (x->order > y->order) - (x->order < y->order);
+}
+
+static void *grow(void *p, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap) return p;
+    *cap = need > *cap * 2 ? need : *cap * 2;
+    p = realloc(p, *cap * size);
+    if (!p) { fprintf(stderr, "wavec: out of memory\n"); exit(1); }
+    return p;
+}
+
+static uint64_t align8(uint64_t v) {
+    return (v + 7) & ~(uint64_t)7;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s waves.txt waves.bin\n", argv[0]);
+        return 1;
+    }
+    src_path = argv[1];
+    FILE *in = fopen(src_path, "r");
+    if (!in) { fprintf(stderr, "wavec: cannot open %s\n", src_path); return 1; }
+
+    Spawner   spawners[MAX_SPAWNERS];
+    int       spawner_count = 0;
+    WaveInfo *waves = NULL;
+    WaveEvent *events = NULL;
+    Pending  *pending = NULL;
+    size_t    wave_cap = 0, event_cap = 0, pending_cap = 0;
+    size_t    wave_count = 0, event_count = 0, pending_count = 0;
+    uint64_t  order = 0;
+
+    char line[1024];
+    for (;;) {
+        bool eof = !fgets(line, sizeof(line), in);
+        if (!eof) src_line++;
+        char *word[MAX_WORDS];
+        int n = 0;
+        if (!eof) {
+            char *hash = strchr(line, '#');
+            if (hash) *hash = 0;
+            for (char *t = strtok(line, " \t\r\n"); t; t = strtok(NULL, " \t\r\n")) {
+                if (n == MAX_WORDS) fail("too many words", NULL);
+                word[n++] = t;
+            }
+            if (!n) continue;
+        }
+
+        // a new wave (or the end of the file) closes the current one
+        if ((eof || !strcmp(word[0], "wave")) && wave_count) {
+            WaveInfo *w = &waves[wave_count - 1];
+            qsort(pending, pending_count, sizeof(Pending), by_time);
+            events = grow(events, &event_cap, event_count + pending_count, sizeof(WaveEvent));
+            w->first_event = event_count;
+            w->event_count = (uint32_t)pending_count;
+            for (size_t i = 0; i < pending_count; ++i) {
+                events[event_count++] = pending[i].e;
+                if (pending[i].e.hp > w->max_hp)       w->max_hp    = pending[i].e.hp;
+                if (pending[i].e.speed > w->max_speed) w->max_speed = pending[i].e.speed;
+            }
+            pending_count = 0;
+        }
+        if (eof) break;
+
+        if (!strcmp(word[0], "spawner")) {
+            if (n != 4) fail("usage: spawner NAME X Y", NULL);
+            if (wave_count) fail("spawners must come before the first wave", NULL);
+            if (spawner_count == MAX_SPAWNERS) fail("too many spawners", NULL);
+            Spawner *s = &spawners[spawner_count++];
+            snprintf(s->name, sizeof(s->name), "%s", word[1]);
+            s->pos = (WaveSpawner){ parse_float(word[2]), parse_float(word[3]) };
+        } else if (!strcmp(word[0], "wave")) {
+            waves = grow(waves, &wave_cap, wave_count + 1, sizeof(WaveInfo));
+            float brk = DEFAULT_BREAK_S;
+            for (int i = 1; i < n; i += 2) {
+                if (i + 1 >= n || strcmp(word[i], "break")) fail("usage: wave [break SECONDS]", NULL);
+                brk = parse_float(word[i + 1]);
+            }
+            waves[wave_count++] = (WaveInfo){ .break_ms = (uint32_t)(brk * 1000 + 0.5f) };
+        } else if (!strcmp(word[0], "at")) {
+            if (!wave_count) fail("'at' before the first wave", NULL);
+            if (n < 5 || strcmp(word[2], "spawn")) fail("usage: at SECONDS spawn COUNT SPAWNER [options]", NULL);
+            float at = parse_float(word[1]), over = 0, hp = DEFAULT_HP, speed = DEFAULT_SPEED;
+            char *end;
+            long count = strtol(word[3], &end, 10);
+            if (end == word[3] || *end) fail("expected a count, got", word[3]);
+            int type = 0;
+            uint16_t from;
+            if (count <= 0) fail("spawn count must be positive:", word[3]);
+            if ((unsigned long)count > WAVES_MAX_WAVE_EVENTS - pending_count)
+                fail("too many events in one wave:", word[3]);
+            if (!strcmp(word[4], "random")) {
+                from = WAVES_RANDOM_SPAWNER;
+            } else {
+                int k = 0;
+                while (k < spawner_count && strcmp(spawners[k].name, word[4])) ++k;
+                if (k < spawner_count) from = (uint16_t)k;
+                else if (!spawner_count) from = (uint16_t)parse_float(word[4]);
+                else fail("unknown spawner", word[4]);
+            }
+            for (int i = 5; i < n; i += 2) {
+                if (i + 1 >= n) fail("missing value for", word[i]);
+                if      (!strcmp(word[i], "over"))  over  = parse_float(word[i + 1]);
+                else if (!strcmp(word[i], "hp"))    hp    = parse_float(word[i + 1]);
+                else if (!strcmp(word[i], "speed")) speed = parse_float(word[i + 1]);
+                else if (!strcmp(word[i], "type"))  type  = parse_type(word[i + 1]);
+                else fail("unknown option", word[i]);
+            }
+            if (at < 0 || over < 0 || hp <= 0 || speed < 0 || type < 0 || type >= WAVE_TYPES)
+                fail("value out of range", NULL);
+            pending = grow(pending, &pending_cap, pending_count + (size_t)count, sizeof(Pending));
+            for (long i = 0; i < count; ++i) {
+                float t = at + (count > 1 ? over * i / count : 0);
+                pending[pending_count++] = (Pending){
+                    .e = { .ms = (uint32_t)(t * 1000 + 0.5f), .spawner = from, .type = (uint8_t)type,
+                           .hp = hp, .speed = speed },
+                    .order = order++ };
+            }
+        } else {
+            fail("unknown statement", word[0]);
+        }
+    }
+    fclose(in);
+    if (!wave_count) { fprintf(stderr, "%s: no waves\n", src_path); return 1; }
+
+    WavesHeader h = { .version = WAVES_VERSION, .event_size = sizeof(WaveEvent),
+                      .spawner_count = (uint32_t)spawner_count, .wave_count = (uint32_t)wave_count,
+                      .event_count = event_count };
+    memcpy(h.magic, WAVES_MAGIC, 4);
+    h.spawner_offset = align8(sizeof(h));
+    h.wave_offset    = align8(h.spawner_offset + spawner_count * sizeof(WaveSpawner));
+    h.event_offset   = align8(h.wave_offset + wave_count * sizeof(WaveInfo));
+
+    FILE *out = fopen(argv[2], "wb");
+    if (!out) { fprintf(stderr, "wavec: cannot create %s\n", argv[2]); return 1; }
+    static const uint8_t zero[8];
+    bool ok = fwrite(&h, sizeof(h), 1, out) == 1;
+    ok = ok && fwrite(zero, 1, h.spawner_offset - sizeof(h), out) == h.spawner_offset - sizeof(h);
+    for (int i = 0; i < spawner_count && ok; ++i)
+        ok = fwrite(&spawners[i].pos, sizeof(WaveSpawner), 1, out) == 1;
+    uint64_t at = h.spawner_offset + spawner_count * sizeof(WaveSpawner);
+    ok = ok && fwrite(zero, 1, h.wave_offset - at, out) == h.wave_offset - at;
+    ok = ok && fwrite(waves, sizeof(WaveInfo), wave_count, out) == wave_count;
+    at = h.wave_offset + wave_count * sizeof(WaveInfo);
+    ok = ok && fwrite(zero, 1, h.event_offset - at, out) == h.event_offset - at;
+    ok = ok && fwrite(events, sizeof(WaveEvent), event_count, out) == event_count;
+    ok = fclose(out) == 0 && ok;
+    if (!ok) { fprintf(stderr, "wavec: write to %s failed\n", argv[2]); return 1; }
+
+    printf("%s: %zu wave(s), %zu event(s), %d spawner(s)\n", argv[2], wave_count, event_count, spawner_count);
+    free(waves);
+    free(events);
+    free(pending);
+    return 0;
+}
@@ -0,0 +1,61 @@
+//------------------------------------------------------------
+// waves.h – compiled wave file format shared by the game and tools/
+//------------------------------------------------------------
+#ifndef WAVES_H
+#define WAVES_H
+
+#include <stdint.h>
+
+#define WAVES_MAGIC           "WAV1"
+#define WAVES_VERSION         1
+#define WAVES_RANDOM_SPAWNER  0xFFFF  // pick one of the spawners at spawn time
+#define WAVES_MAX_WAVE_EVENTS 0x7FFFFFFF  // per wave, so a cursor fits in an int
+
+// WaveEvent.type: what spawns. Everything but chasers also shoots.
+enum {
+    WAVE_CHASER,                 // melee only
+    WAVE_RING,                   // evenly spaced ring of shots
+    WAVE_SPIRAL,                 // a few arms that turn a little each volley
+    WAVE_AIMED,                  // narrow fan at the player
+    WAVE_TYPES
+};
+
+// The file is one header followed by the three tables it points at, each
+// 8-byte aligned. Offsets are from the start of the file.
+typedef struct {
+    char     magic[4];
+    uint32_t version;
+    uint32_t event_size;         // sizeof(WaveEvent)
+    uint32_t spawner_count;      // 0 = use the game's built-in spawners
+    uint32_t wave_count;
+    uint32_t reserved;
+    uint64_t event_count;
+    uint64_t spawner_offset;     // WaveSpawner[spawner_count]
+    uint64_t wave_offset;        // WaveInfo[wave_count]
+    uint64_t event_offset;       // WaveEvent[event_count]
+} WavesHeader;
+
+typedef struct {
+    float x, y;                  // arena units
+} WaveSpawner;
+
+// Events of one wave are contiguous and sorted by time. max_hp/max_speed
+// let the game size per-wave quantities without scanning the events.
+typedef struct {
+    uint64_t first_event;
+    uint32_t event_count;
+    uint32_t break_ms;           // pause after the wave is cleared
+    float    max_hp;
+    float    max_speed;
+} WaveInfo;
+
+typedef struct {
+    uint32_t ms;                 // since the wave started
+    uint16_t spawner;            // index, or WAVES_RANDOM_SPAWNER
+    uint8_t  type;               // WAVE_CHASER...
+    uint8_t  reserved;
+    float    hp;
+    float    speed;              // px/s
+} WaveEvent;
+
+#endif